@@ -0,0 +1,84 @@
+# Memory footprint report and budget check - PlatformIO extra script (see platformio.ini)
+#
+# After every build it sorts the symbols of firmware.elf into the ESP32 memory regions
+# (IRAM code, DRAM data/bss, flash code, flash constants), prints the total of each and the
+# biggest symbols, and fails the build if a region is over its budget.
+#
+#   pio run                  - build, then check the budgets (if any are set)
+#   pio run -t footprint     - just the report (with more symbols)
+#
+# Budgets are the custom_budget_* options in platformio.ini (bytes). None are set yet: take the
+# totals of one release build and add a margin (say 10%), so that a change that grows a region
+# by more than that fails. A region without a budget is only reported.
+
+import subprocess
+
+Import("env")
+
+# ESP32 address ranges
+REGIONS = [
+    ("iram",      0x40080000, 0x400A0000),
+    ("dram",      0x3FFAE000, 0x40000000),
+    ("flash",     0x400C2000, 0x40C00000),
+    ("flash_ro",  0x3F400000, 0x3F800000),
+]
+
+
+def read_symbols(elf):
+    nm = env.subst("$CC").replace("gcc", "nm")
+    out = subprocess.run([nm, "-S", "-C", "--size-sort", elf], capture_output=True, text=True, check=True).stdout
+    symbols = []
+    for line in out.splitlines():
+        parts = line.split(None, 3)
+        if len(parts) < 4:
+            continue
+        addr, size, kind, name = int(parts[0], 16), int(parts[1], 16), parts[2], parts[3]
+        for region, start, end in REGIONS:
+            if start <= addr < end:
+                symbols.append((region, size, kind, name))
+                break
+    return symbols
+
+
+def report(elf, top):
+    symbols = read_symbols(elf)
+    totals = {}
+    print("\nMemory footprint (%s)" % elf)
+    for region, _, _ in REGIONS:
+        inside = sorted((s for s in symbols if s[0] == region), key=lambda s: -s[1])
+        totals[region] = sum(s[1] for s in inside)
+        print("\n  %-8s %8d bytes" % (region, totals[region]))
+        for _, size, kind, name in inside[:top]:
+            print("    %8d  %s  %s" % (size, kind, name[:90]))
+    return totals
+
+
+def check(source, target, env):
+    totals = report(str(target[0]), 8)
+    over = []
+    checked = 0
+    for region, _, _ in REGIONS:
+        budget = env.GetProjectOption("custom_budget_" + region, "")
+        if not budget:
+            continue
+        checked += 1
+        if totals[region] > int(budget):
+            over.append("%s %d > %s" % (region, totals[region], budget))
+    if over:
+        print("\nFOOTPRINT OVER BUDGET: " + ", ".join(over))
+        env.Exit(1)
+    print("\nFootprint within budget" if checked else "\nNo footprint budgets set - report only")
+
+
+def footprint(target, source, env):
+    report(env.subst("$BUILD_DIR/${PROGNAME}.elf"), 30)
+
+
+env.AddPostAction("$BUILD_DIR/${PROGNAME}.elf", check)
+env.AddCustomTarget(
+    name="footprint",
+    dependencies="$BUILD_DIR/${PROGNAME}.elf",
+    actions=footprint,
+    title="Footprint",
+    description="Per symbol RAM / IRAM / flash report",
+)
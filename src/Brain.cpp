@@ -31,8 +31,24 @@ Brain::Brain(const char* sName) {
 
     // default to Serial so brainStream->println() works out of the box
     brainStream = &Serial;
+    source = NULL;
+
+    packetArrivalUs = packetReadUs = packetParsedUs = 0;
+    consumedSeq = 0;
+    packetSeq = 0;
+    packetsDropped = 0;
+    memset(&parsed, 0, sizeof(parsed));
+    payload = packetData;
+    packetQueue = xQueueCreate(BRAIN_QUEUE_LEN, sizeof(BrainPacket));
+    bytesSeen = syncsSeen = rawSeen = rawRailed = 0;
+    rawValue = 0;
+    memset(powerBands, 0, sizeof(powerBands));
+    powerAttention = powerQuality = 0;
+    powerSeq = 0;
+    chunkArrivalUs = chunkReadUs = 0;
 
     // ensure attentionAvg is clear (constructor already does this, but safe)
+    attentionAvg.setWindow(DEFAULT_AVERAGING_LENGTH);
     attentionAvg.clear();
 
     clearEegPower();
@@ -76,7 +92,7 @@ uint8_t approximateAttention(uint32_t deltaP,
   att *= qFactor;*/
 
   // Optional: low-quality hard gate
-  if (quality > 55) att = 0;
+  if (quality > qualityGate) att = 0;
 
   // Clamp & return
   if (att < 0.0f) att = 0.0f;
@@ -84,12 +100,67 @@ uint8_t approximateAttention(uint32_t deltaP,
   return (uint8_t)(att + 0.5f);
 }
 
+void Brain::setSource(ByteSource* src) {
+    source = src;
+}
+
+boolean Brain::poll(uint32_t arrivalUs) {
+    if (source == NULL)
+        return false;
+
+    boolean gotPacket = false;
+    const uint8_t* data;
+    size_t n;
+    // up to a whole chunk - a band power packet (36 bytes on the wire) can then be parsed in place (update())
+    while ((n = source->read(&data, TRANSPORT_CHUNK)) > 0) {
+        chunkReadUs = micros();
+        chunkArrivalUs = arrivalUs ? arrivalUs : chunkReadUs;
+        gotPacket |= update(data, n);
+    }
+    return gotPacket;
+}
+
+// hot path - every byte from the headsets. Not IRAM_ATTR: a finished packet runs parsePacket()
+// and the error prints from flash anyway, and no bench run has shown IRAM helps here.
+// A payload is checksummed where it lies in pBuf, and parsed from there if its checksum byte is
+// in the same read - only a packet split across reads is copied into packetData.
+boolean Brain::update(const uint8_t* pBuf, size_t length) {
+    boolean gotPacket = false;
+    size_t i = 0;
+    while (i < length) {
+        if (inPacket && packetIndex > 0 && packetIndex <= packetLength) {
+            size_t n = packetLength - packetIndex + 1; // payload bytes still to come
+            if (n > length - i)
+                n = length - i;
+            const uint8_t* run = pBuf + i;
+            for (size_t k = 0; k < n; k++)
+                checksumAccumulator += run[k];
+            if (packetIndex == 1 && n == packetLength && i + n < length) {
+                payload = run; // all of it, and the checksum byte after it, in this read
+            }
+            else {
+                memcpy(packetData + packetIndex - 1, run, n);
+                payload = packetData;
+            }
+            packetIndex += n;
+            bytesSeen += n;
+            lastByte = run[n - 1];
+            i += n;
+        }
+        else {
+            gotPacket |= update(pBuf[i++]);
+        }
+    }
+    return gotPacket;
+}
+
 boolean Brain::update(uint8_t latestByte)
 {
     //Serial.print(latestByte);
     //return false;
 
     bool freshPacket = false;
+    bytesSeen++;
 
     // Build a packet if we know we're and not just listening for sync bytes.
     if (inPacket) {
@@ -97,6 +168,7 @@ boolean Brain::update(uint8_t latestByte)
         if (packetIndex == 0) {
             //Serial.print("(Byte1)");
             packetLength = latestByte;
+            payload = packetData;
 
             // Catch error if packet is too long
             if (packetLength > MAX_PACKET_LENGTH) {
@@ -107,6 +179,7 @@ boolean Brain::update(uint8_t latestByte)
         else if (packetIndex <= packetLength) {
             // data bytes - Store the byte in an array for parsing later.
             packetData[packetIndex - 1] = latestByte;
+            payload = packetData;
             // Keep building the checksum.
             checksumAccumulator += latestByte;
         }
@@ -118,7 +191,7 @@ boolean Brain::update(uint8_t latestByte)
 
             // Do they match?
             if (checksum == checksumAccumulator) {
-                boolean parseSuccess = parsePacket();
+                boolean parseSuccess = parsePacket(payload);
 
                 if (parseSuccess){
                     freshPacket = true;
@@ -144,40 +217,81 @@ boolean Brain::update(uint8_t latestByte)
     // Look for the start of the packet
     if ((latestByte == 170) && (lastByte == 170) && !inPacket) {
         // Start of packet
+        syncsSeen++;
         inPacket = true;
         packetIndex = 0;
         checksumAccumulator = 0;
     }
     lastByte = latestByte; // Keep track of the last byte so we can find the sync byte pairs.
 
-    if(freshPacket){
-        signalQualityNotEstimated = signalQuality; //save the real signal quality before we mess with it
-        // If we have a fresh packet, we can calculate the attention.
-        if (signalQuality>0 && signalQuality < 55)
-        {//if we have any signal - going to have make do with what we have
-            attention = approximateAttention(
-                eegPower[0], //deltaP,
-                eegPower[1], //thetaP,
-                eegPower[2], eegPower[3],//  lowAlphaP, highAlphaP,
-                eegPower[4],  eegPower[5],// lowBetaP,  highBetaP,
-                eegPower[6],  eegPower[7], // lowGammaP, midGammaP,
-                signalQuality);
-
-            brainStream->print("\n[Estimate: "); brainStream->print(sName);
-            Serial.print(" Q:");  Serial.print(signalQuality);
-            Serial.print(" attn:");  Serial.print(attention); Serial.println("]");
-            attentionAvg.add(attention);
-            signalQuality = 0; //force it to be good
-        }
-        if (signalQuality >= 55){
-            //no one there...
-            attention = 0;
-            attentionAvg.clear();
+    if (freshPacket) {
+        // the rest of the work on a packet is loop()'s - consume()
+        packetSeq++;
+        if (parsed.fields != 0) {// raw samples alone are only counted (presence.h)
+            parsed.seq = packetSeq;
+            parsed.arrivalUs = chunkArrivalUs;
+            parsed.readUs = chunkReadUs;
+            parsed.parsedUs = micros();
+            if (packetQueue == NULL || xQueueSend(packetQueue, &parsed, 0) != pdTRUE)
+                packetsDropped++;
         }
     }
     return freshPacket;
 }
 
+boolean Brain::nextPacket(BrainPacket& packet) {
+    return packetQueue != NULL && xQueueReceive(packetQueue, &packet, 0) == pdTRUE;
+}
+
+void Brain::consume(const BrainPacket& packet) {
+    if (packet.fields & BRAIN_HAS_QUALITY)
+        signalQuality = packet.signalQuality;
+    if (packet.fields & BRAIN_HAS_ATTENTION)
+        attention = packet.attention;
+    if (packet.fields & BRAIN_HAS_MEDITATION)
+        meditation = packet.meditation;
+    hasPower = (packet.fields & BRAIN_HAS_POWER) != 0;
+    if (hasPower)
+        memcpy(eegPower, packet.eegPower, sizeof(eegPower));
+    else
+        clearEegPower(); // be honest about missing values
+    packetArrivalUs = packet.arrivalUs;
+    packetReadUs = packet.readUs;
+    packetParsedUs = packet.parsedUs;
+    consumedSeq = packet.seq;
+
+    attentionAvg.setWindow(averagingLength); // pick up a changed setting at a packet boundary
+    signalQualityNotEstimated = signalQuality; //save the real signal quality before we mess with it
+    // If we have a fresh packet, we can calculate the attention.
+    if (signalQuality>0 && signalQuality < qualityGate)
+    {//if we have any signal - going to have make do with what we have
+        attention = approximateAttention(
+            eegPower[0], //deltaP,
+            eegPower[1], //thetaP,
+            eegPower[2], eegPower[3],//  lowAlphaP, highAlphaP,
+            eegPower[4],  eegPower[5],// lowBetaP,  highBetaP,
+            eegPower[6],  eegPower[7], // lowGammaP, midGammaP,
+            signalQuality);
+
+        brainStream->print("\n[Estimate: "); brainStream->print(sName);
+        Serial.print(" Q:");  Serial.print(signalQuality);
+        Serial.print(" attn:");  Serial.print(attention); Serial.println("]");
+        attentionAvg.add(attention);
+        signalQuality = 0; //force it to be good
+    }
+    if (signalQuality >= qualityGate){
+        //no one there...
+        attention = 0;
+        attentionAvg.clear();
+    }
+    if (hasPower) {
+        memcpy(powerBands, eegPower, sizeof(powerBands));
+        powerAttention = attention;
+        powerQuality = signalQualityNotEstimated;
+        powerSeq++;
+    }
+}
+
 void Brain::clearPacket() {
     for (uint8_t i = 0; i < MAX_PACKET_LENGTH; i++) {
         packetData[i] = 0;
@@ -191,47 +305,61 @@ void Brain::clearEegPower() {
     }
 }
 
-boolean Brain::parsePacket() {
-    // Loop through the packet, extracting data.
+boolean Brain::parsePacket(const uint8_t* data) {
+    // Loop through the packet, extracting data into parsed.
     // Based on mindset_communications_protocol.pdf from the Neurosky Mindset SDK.
     // Returns true if passing succeeds
-    hasPower = false;
+    // data may be the source's own buffer (see update()) - nothing reads past packetLength
+    parsed.fields = 0;
     boolean parseSuccess = true;
-    int rawValue = 0;
 
-    clearEegPower();    // clear the eeg power to make sure we're honest about missing values
+    memset(parsed.eegPower, 0, sizeof(parsed.eegPower)); // make sure we're honest about missing values
 
     for (uint8_t i = 0; i < packetLength; i++) {
-        switch (packetData[i]) {
+        uint8_t left = packetLength - i - 1; // bytes after the code
+        switch (data[i]) {
             case 0x2:
-                signalQuality = packetData[++i];
+                if (left < 1) return false;
+                parsed.signalQuality = data[++i];
+                parsed.fields |= BRAIN_HAS_QUALITY;
                 break;
             case 0x4:
-                attention = packetData[++i];
+                if (left < 1) return false;
+                parsed.attention = data[++i];
+                parsed.fields |= BRAIN_HAS_ATTENTION;
                 break;
             case 0x5:
-                meditation = packetData[++i];
+                if (left < 1) return false;
+                parsed.meditation = data[++i];
+                parsed.fields |= BRAIN_HAS_MEDITATION;
                 break;
             case 0x83:
                 // ASIC_EEG_POWER: eight big-endian 3-uint8_t unsigned integer values representing delta, theta, low-alpha high-alpha, low-beta, high-beta, low-gamma, and mid-gamma EEG band power values
                 // The next uint8_t sets the length, usually 24 (Eight 24-bit numbers... big endian?)
                 // We dont' use this value so let's skip it and just increment i
+                if (left < 1 + 3 * EEG_POWER_BANDS) return false;
                 i++;
 
                 // Extract the values
                 for (int j = 0; j < EEG_POWER_BANDS; j++) {
-                    eegPower[j] = ((uint32_t)packetData[++i] << 16) | ((uint32_t)packetData[++i] << 8) | (uint32_t)packetData[++i];
+                    parsed.eegPower[j] = ((uint32_t)data[i + 1] << 16) | ((uint32_t)data[i + 2] << 8) | (uint32_t)data[i + 3];
+                    i += 3;
                 }
 
-                hasPower = true;
+                parsed.fields |= BRAIN_HAS_POWER;
                 // This seems to happen once during start-up on the force trainer. Strange. Wise to wait a couple of packets before
                 // you start reading.
                 break;
             case 0x80:
-                // We dont' use this value so let's skip it and just increment i
-                // uint8_t packetLength = packetData[++i];
+                // RAW_WAVE: a length byte (always 2) we skip, then one signed 16-bit sample
+                // - the presence detector watches these for a sensor off the skin
+                if (left < 3) return false;
                 i++;
-                rawValue = ((int)packetData[++i] << 8) | packetData[++i];
+                rawValue = (int16_t)(((uint16_t)data[i + 1] << 8) | data[i + 2]); // signed, big endian
+                i += 2;
+                rawSeen++;
+                if (rawValue >= PRESENCE_RAW_RAIL || rawValue <= -PRESENCE_RAW_RAIL)
+                    rawRailed++;
                 break;
             default:
                 // Broken packet ?
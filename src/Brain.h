@@ -1,11 +1,43 @@
 #pragma once
 
 #include "Arduino.h"
+#include <freertos/FreeRTOS.h>
+#include <freertos/queue.h>
 #include "RollingAverage.h"
 #include "config.h"
+#include "transport.h"
 
 #define MAX_PACKET_LENGTH 32
 #define EEG_POWER_BANDS 8
+#define BRAIN_QUEUE_LEN 8        // parsed packets waiting for loop() - seconds of 1 Hz packets
+
+// what a packet carried - BrainPacket::fields
+#define BRAIN_HAS_QUALITY    0x01
+#define BRAIN_HAS_ATTENTION  0x02
+#define BRAIN_HAS_MEDITATION 0x04
+#define BRAIN_HAS_POWER      0x08
+
+// A parsed packet on its way from the parser (the SerialAB task) to loop() - see poll() and consume()
+struct BrainPacket
+{
+    uint16_t seq;               // packetSeq
+    uint8_t fields;             // BRAIN_HAS_...
+    uint8_t signalQuality;      // the headset's own
+    uint8_t attention;
+    uint8_t meditation;
+    uint32_t arrivalUs;         // its checksum byte arrived (as near as the source can tell)
+    uint32_t readUs;            // read from the source
+    uint32_t parsedUs;          // framed, checksummed and parsed
+    uint32_t eegPower[EEG_POWER_BANDS];
+};
+
+// Estimate attention (0..100) from the eight band powers - used when the headset's own attention is unreliable
+uint8_t approximateAttention(uint32_t deltaP,
+                             uint32_t thetaP,
+                             uint32_t lowAlphaP, uint32_t highAlphaP,
+                             uint32_t lowBetaP,  uint32_t highBetaP,
+                             uint32_t lowGammaP, uint32_t midGammaP,
+                             uint8_t quality);
 
 class Brain {
     public:
@@ -13,10 +45,26 @@ class Brain {
 
         uint8_t getAverage();
 
-        // Run this in the main loop.
-        //boolean update(uint8_t* pBuf, int length);
+        // Where the headset bytes come from (a UART, Bluetooth, a capture...) - see transport.h
+        void setSource(ByteSource* source);
+
+        // The parser task. Parses everything the source has - true if a new packet arrived.
+        // Only the framing, checksum and fields are done here: packets with readings are queued
+        // for loop() (nextPacket() / consume()), raw samples are only counted.
+        // arrivalUs - when the source says these bytes arrived (micros), 0 = not known, use now
+        boolean poll(uint32_t arrivalUs = 0);
+
+        // Parse bytes - true if any of them completed a packet.
+        boolean update(const uint8_t* pBuf, size_t length);
         boolean update(uint8_t update_byte);
 
+        // loop() - the oldest queued packet, false if there is none
+        boolean nextPacket(BrainPacket& packet);
+
+        // loop() - take a queued packet into the readings below: the attention estimate for a
+        // poor signal, the rolling average, the band power snapshot
+        void consume(const BrainPacket& packet);
+
         // String with most recent error.
         char* readErrors();
 
@@ -43,9 +91,36 @@ class Brain {
         uint8_t meditation;
         uint8_t attention;
 
+        // The latest consume()d packet - when it got here (micros), for the latency trace (latency.h)
+        uint32_t packetArrivalUs;   // its checksum byte arrived (as near as the source can tell)
+        uint32_t packetReadUs;      // read from the source
+        uint32_t packetParsedUs;    // framed, checksummed and parsed
+        uint16_t consumedSeq;       // its packetSeq
+
+        uint16_t packetSeq;         // counts good packets (parser task - raw samples too)
+        uint32_t packetsDropped;    // queue full - loop() fell behind
+
+        // Link activity - read by the presence detector (presence.h), they only count up
+        uint32_t bytesSeen;         // every byte from the source
+        uint32_t syncsSeen;         // 0xAA 0xAA pairs - a packet starting
+        uint32_t rawSeen;           // raw wave samples (0x80) - 512 a second from a headset streaming them
+        uint32_t rawRailed;         // raw samples at the rails (|v| >= PRESENCE_RAW_RAIL)
+        int16_t rawValue;           // the latest raw sample
+
+        // The latest packet with band powers - eegPower is cleared by every packet, this is not.
+        // For the band power history (history.h).
+        uint32_t powerBands[EEG_POWER_BANDS];
+        uint8_t powerAttention;     // the attention the game used (estimated if it had to be)
+        uint8_t powerQuality;       // the headset's own signal quality
+        uint16_t powerSeq;          // counts packets with band powers
+
     private:
         //static RunningMedian AttentionAvg;
         Stream* brainStream;
+        ByteSource* source;
+        QueueHandle_t packetQueue;
+        BrainPacket parsed;         // the packet being parsed
+        const uint8_t* payload;     // its bytes - in the source's buffer, or packetData if it was split across reads
         uint8_t packetData[MAX_PACKET_LENGTH];
         boolean inPacket;
         uint8_t latestByte;
@@ -56,20 +131,22 @@ class Brain {
         uint8_t checksumAccumulator;
         uint8_t eegPowerLength;
         boolean hasPower;
+        uint32_t chunkArrivalUs;    // stamps of the bytes being parsed
+        uint32_t chunkReadUs;
         void clearPacket();
         void clearEegPower();
-        boolean parsePacket();
+        boolean parsePacket(const uint8_t* data);
 
         void printPacket();
         void init();
         void printCSV(); // maybe should be public?
         void printDebug();
 
-        RollingAverage<uint8_t> attentionAvg = RollingAverage<uint8_t>(averagingLength); // 10-sample window (adjust as needed)
+        RollingAverage<uint8_t, MAX_AVERAGING_LENGTH> attentionAvg; // window is set from averagingLength
 
         //char csvBuffer[100];
         boolean freshPacket;
 
-        //
+        // the latest consume()d packet's band powers - cleared by a packet without them
         uint32_t eegPower[EEG_POWER_BANDS];
 };
@@ -19,8 +19,12 @@
     - Changes to LED strip and other hardware are in config.h
     - Change the strip type to what you are using and compile/load firmware
     - Use Serial port or Wifi to set your strip length.
+      (type "list" in the serial monitor to see the settings - see settings.h)
 */
 
+// the attract effects' clock - FastLED's beat functions read it too, so a test scene can stop it
+unsigned long effect_millis(); // screensavers.h
+#define GET_MILLIS effect_millis
 #include <FastLED.h>
 #include "Arduino.h"
 #include <RunningMedian.h>
@@ -29,10 +33,25 @@
 #include "config.h"
 #include "particle.h"
 #include "sound.h"
+#include "arena.h"
 #include "sfx.h"
-
-//#include "bluetooth_ap.h"
+#include "tasks.h"
+#include "settings.h"
+#include "recorder.h"
+#include "compositor.h"
+#include "framecap.h"
+#include "diag.h"
+#include "scheduler.h"
+#include "telemetry.h"
+#include "latency.h"
+#include "meters.h"
+#include "power.h"
+#include "boot.h"
+
+//#include "bluetooth_ap.h" - for a wireless headset A build [env:bt] (-DTUG_BLUETOOTH): it reads from a BluetoothSource (transport.h, serial_ap.h)
 #include "serial_ap.h"
+#include "presence.h"
+#include "predictor.h"
 
 #if defined(FASTLED_VERSION) && (FASTLED_VERSION < 301000)
 #error "Requires FastLED 3.1 or later; check github for latest code."
@@ -41,45 +60,16 @@
 
 //procedure declarations
 void getInput();
+bool tickArena(unsigned long millisNow);
 
 //#define VERSION_2 true  //uncomment for a more epic battle
 
-int playerA = 0; // Stores the player A power value (0-PLAYERMAX)
-int playerB = 0; // Stores the player A power value (0-PLAYERMAX)
-
-int playerA_Cal = 0; //Average of player A power values before game starts
-int playerB_Cal = 0; //Average of player A power values before game starts
-
-
-CRGB leds[NUM_LEDS+5];
 extern int bDebug;
 
-#define PARTICLE_COUNT 100
-Particle particlePool[PARTICLE_COUNT] = {
-    Particle(), Particle(), Particle(), Particle(), Particle(), Particle(), Particle(), Particle(), Particle(), Particle(), Particle(), Particle(), Particle(), Particle(), Particle(), Particle(), Particle(), Particle(), Particle(), Particle(), Particle(), Particle(), Particle(), Particle(), Particle(), Particle(), Particle(), Particle(), Particle(), Particle(), Particle(), Particle(), Particle(), Particle(), Particle(), Particle(), Particle(), Particle(), Particle(), Particle()};
-
-enum stages
-{
-  STARTUP,    //startup sequence
-  CALIBRATE, //calibration sequence
-  PLAY,   //playing the game 
-  DEAD, //dead sequence
-  SCREENSAVER  // screensaver
-} stage;
-
-// Timings
-unsigned long previousMillis = 0; // Time of the last redraw
-unsigned long lastInputTime = 0;  //last time there was input
-unsigned long timeOfStageStart;    // Stores the time the current Game Started
-
-
-int puckPosition;         // Stores the puck position (0..NUM_LEDS-1)
-int puckPositionHighRes;  // Stores the puck position at a higher resolution
+// the game state - stage, timers, players, puck, particles and strip - is per arena (see arena.h)
 
-
-//Multithreadded stuff
+//Multithreadded stuff - task cores and priorities are in tasks.h
 // -- Task handles for use in the notifications
-#define FASTLED_SHOW_CORE 0 // -- The core to run FastLED.show()
 static TaskHandle_t FastLEDshowTaskHandle = 0;
 static TaskHandle_t userTaskHandle = 0;
 
@@ -87,6 +77,14 @@ static TaskHandle_t userTaskHandle = 0;
 #include "Brain.h"
 Brain brainA("A");
 Brain brainB("B");
+#if TUG_ARENAS > 1
+Brain brainC("C"); // the second arena's headsets
+Brain brainD("D");
+#endif
+
+#ifdef TUG_BENCH
+#include "bench.h"  // build with [env:bench]
+#endif
 
 /** FastLEDshowESP32()
  *  Call this function instead of FastLED.show(). It signals core 0 to issue a show,
@@ -130,134 +128,215 @@ void FastLEDshowTask(void *pvParameters)
 }
 
 void display_setup(){
-  //setup the display pins
-  pinMode(led1Pin, OUTPUT);
-  pinMode(led2Pin, OUTPUT);
-  analogWrite(led1Pin, 0); // off
-  analogWrite(led2Pin, 0); // off
+  //setup the display pins - LEDC channels with hardware fades (see meters.h)
+  meters_setup();
 }
 
 void setup()
 {
+  boot_mark(BOOT_SETUP);
   Serial.begin(115200);
   logln("\r\nTUG32 VERSION: ");
   logln(VERSION);
+  logln(variant.name);
+
+  settings_setup(); // load the saved settings before anything uses them
+  boot_mark(BOOT_SETTINGS);
+  boot_setup(); // the recorder's file system and telemetry WiFi come up on the Boot task (see boot.h)
+  framecap_setup();
+  console_add("jitter", jitterCommand);
+  latency_setup();
+  rng_setup();
+  diag_setup();
 
-  //important- make sure no old fastled in arduino library - needs latest for rgbw
-  FastLED.addLeds<WS2812, FASTLED_DATA_PIN, GRB>(leds, NUM_LEDS).setRgbw(RgbwDefault());
+  bt_setup(); // headsets first - they are read while the startup animation plays
+  presence_setup();
+  history_setup();
+  boot_mark(BOOT_HEADSETS);
 
-  FastLED.setBrightness(led_brightness);
-  //FastLED.setDither(1);
+  // brightness, gamma and the RGBW white channel are done before the show (see pixels.h)
+  pixels_setup();
 
   // -- Create the ESP32 FastLED show task
-  xTaskCreatePinnedToCore(FastLEDshowTask, "FastLEDshowTask", 2048, NULL, 2, &FastLEDshowTaskHandle, FASTLED_SHOW_CORE);
+  task_create(FastLEDshowTask, "FastLEDshowTask", TASK_SHOW, &FastLEDshowTaskHandle);
+  boot_mark(BOOT_PIXELS);
   
   sound_init(DAC_AUDIO_PIN);
-
-  bt_setup();
+  boot_mark(BOOT_SOUND);
 
   display_setup();
+  boot_mark(BOOT_METERS);
+
+  arena_setup(headsets); // every arena starts with the startup sequence
+
+  #ifdef TUG_BENCH
+    bench_setup(); // the benchmarks run when boot is done - so they are not in the boot time
+  #endif
 
-  stage = STARTUP;
-  timeOfStageStart = millis();
+  scheduler_setup(); // start the frame timer last - loop() runs from the first tick
+  boot_mark(BOOT_LOOP);
 }
 
 void loop()
 {
+  // sleep until the frame timer says it is time for the next frame (see scheduler.h)
+  if (!scheduler_wait())
+    return;
+
+  //here 60 times per second
   unsigned long millisNow = millis();
-  int brightness = 0;
 
-  //sound
-  if(stage == PLAY){
+  jitter_frame();
+  framecap_begin();
+  arena_select(0);
+  settings_tick(millisNow); // serial console - changes are applied here, between frames
+  // the packets parsed since the last frame, in one batch (see serial_ap.h)
+  bt_dispatch(millisNow);
+  // who is at the headsets - updated every frame from the link activity (see presence.h)
+  presence_tick(millisNow);
+  predict_tick(millisNow); // the players' inputs for this frame (see predictor.h)
+
+  // each arena draws its own strip, then one show sends them all (see arena.h)
+  bool idle = true;
+  for (int a = 0; a < TUG_ARENAS; a++)
+  {
+    arena_select(a);
+    idle &= tickArena(millisNow);
+    pixels_convert(a); // brightness, gamma, RGBW -> the bytes the show clocks out
+  }
+  arena_select(0);
+
+  FastLEDshowESP32(); // FastLED.show() but on the show task (see tasks.h)
+  latency_shown();
+  boot_mark(BOOT_FIRST_FRAME);
+  displayTick();
+
+  RecFrame recFrame = {(uint8_t)arena->stage, (int16_t)arena->playerA, (int16_t)arena->playerB, (int16_t)arena->puckPosition,
+                       arena->brainA->signalQualityNotEstimated, arena->brainB->signalQualityNotEstimated};
+  recorder_tick(millisNow, arena->stage == PLAY || arena->stage == DEAD, recFrame);
+  telemetry_tick(millisNow, arena->stage, arena->puckPosition, *arena->brainA, *arena->brainB);
+
+  // nobody playing - drop the frame rate and let the CPU slow down and sleep (see power.h)
+  power_tick(idle, millisNow);
+}
+
+/** tickArena()
+ *  One frame of the selected arena's game, drawn into its strip.
+ *  Returns true if nobody is playing in it.
+ */
+bool tickArena(unsigned long millisNow)
+{
+  //sound - once per frame (only the first arena is heard - see arena.h)
+  if(arena->stage == PLAY){
     //SFXAttention(brainA.getAverage(), brainB.getAverage());
     //SFXAttention(brainA.attention, brainB.attention);
-    SFXPuckPosition(puckPosition);
+    SFXPuckPosition(arena->puckPosition);
   }
-  else if(stage == DEAD){
+  else if(arena->stage == DEAD){
       SFXdead();
   }
 
-  if (millisNow - previousMillis >= MIN_REDRAW_INTERVAL)
-  {//here 60 times per second
-    getInput();
-
-    long frameTimer = millisNow;
-    previousMillis = millisNow;
+  getInput();
 
-    if (brainA.signalQuality >= 100 && brainB.signalQuality >= 100)
-    {//no signal from either brain controller
-      if (stage != SCREENSAVER && lastInputTime + SCREENSAVER_STARTS_TIMEOUT < millisNow)
-      {
-        logln("No signal from either brain, going to screensaver");
-        stage = SCREENSAVER;
-      }
+  if (!presence_any(arena->index, PRESENCE_GOOD))
+  {//no signal from either brain controller
+    if (arena->stage != SCREENSAVER && arena->stage != STARTUP && !presence_any(arena->index, PRESENCE_NO_CONTACT))
+    {// both unplugged - nobody can play, no point waiting
+      logln("Both headsets unplugged, going to screensaver");
+      arena->stage = SCREENSAVER;
     }
-    else{
-      lastInputTime = millisNow; //someone is playing
-      if (stage == SCREENSAVER)
-      {//we were in screensaver, so exit
-        logln("Signal received, exiting screensaver");
-        stage = CALIBRATE; //exit screensaver
-      }
+    else if (arena->stage != SCREENSAVER && arena->lastInputTime + screensaverTimeout < millisNow)
+    {
+      logln("No signal from either brain, going to screensaver");
+      arena->stage = SCREENSAVER;
     }
-
-    if (stage == SCREENSAVER)
-    {//Screensaver 
-      //Enters screensave when no user detected for 5 seconds
-      //Exits Screensaver above when we detect user connected
-      screenSaverTick();
-      //SFXRaceStart(0);
+  }
+  else{
+    arena->lastInputTime = millisNow; //someone is playing
+    if (arena->stage == SCREENSAVER)
+    {//we were in screensaver, so exit
+      logln("Signal received, exiting screensaver");
+      arena->stage = CALIBRATE; //exit screensaver
     }
-    else if (stage == STARTUP)
-    {//this is the startup sequence when powered on
-      //Enters STARTUP only at power on
-      if (tickStartup(millisNow))
-      {//Sequence completed - Exit STARTUP
-        SFXcomplete();
-        startAGame();
+  }
+
+  if (arena->stage == SCREENSAVER)
+  {//Screensaver 
+    //Enters screensave when no user detected for 5 seconds
+    //Exits Screensaver above when we detect user connected
+    screenSaverTick();
+    //SFXRaceStart(0);
+  }
+  else if (arena->stage == STARTUP)
+  {//this is the startup sequence when powered on
+    //Enters STARTUP only at power on
+    // a headset already has contact after the wipe (power cycled mid show?) - skip the rest, straight to the game
+    // (here, not in tickStartup() - the test scenes draw it with headsets on - see framecap.h)
+    bool cutShort = millisNow - arena->timeOfStageStart >= STARTUP_WIPEUP_DUR && presence_any(arena->index, PRESENCE_GOOD);
+    if (cutShort)
+      logln("headset on - startup cut short");
+    if (cutShort || tickStartup(millisNow))
+    {//Sequence completed - Exit STARTUP
+      SFXcomplete();
+      if (arena->index == 0)
+      {
+        boot_ready();
+        #ifdef TUG_BENCH
+          bench_run();
+        #endif
       }
+      startAGame();
     }
-    else if (stage == CALIBRATE)
-    {// CALIBRATE STAGE...  3.2.1 GO!
-      tickCalibrate(millisNow);
-    }
-    else if (stage == PLAY)
+  }
+  else if (arena->stage == CALIBRATE)
+  {// CALIBRATE STAGE...  3.2.1 GO!
+    tickCalibrate(millisNow);
+  }
+  else if (arena->stage == PLAY && presence_any(arena->index, PRESENCE_UNPLUGGED))
+  {// lost a headset mid game - the game is off, back to waiting for both
+    logln("Headset unplugged - game abandoned");
+    startAGame();
+  }
+  else if (arena->stage == PLAY)
+  {
+    // Ticks and draw calls
+    clearFrame();
+    drawPlayers();
+    drawExit();
+  }
+  else if (arena->stage == DEAD)
+  {// DEAD
+    clearFrame();
+    tickDie(millisNow);
+    if (!tickParticles())
     {
-      // Ticks and draw calls
-      FastLED.clear();
-      drawPlayers();
-      drawExit();
-    }
-    else if (stage == DEAD)
-    {// DEAD
-      FastLED.clear();
-      tickDie(millisNow);
-      if (!tickParticles())
-      {
-        startAGame();
-      }
+      startAGame();
     }
-    
-    if (bDebug >= 0)
-        leds[bDebug]= CRGB(255, 255, 0); //debugging led
-
-    FastLEDshowESP32(); // FastLED.show() but on core 0
-    displayTick();
   }
+  
+  if (bDebug >= 0 && bDebug < led_count)
+      layerSet(LAYER_OVERLAY, bDebug, CRGB(255, 255, 0)); //debugging led
+
+  compositor_flatten(); // merge the layers into leds[] (see compositor.h)
+  if (arena->index == 0)
+    framecap_end(); // keep a copy of the frame for the "frames" console command
+
+  return arena->stage == SCREENSAVER || (arena->stage == CALIBRATE && !presence_any(arena->index, PRESENCE_GOOD));
 }
 
 // ------------ LEVELS -------------
 void startAGame()
 {
   // -- Reset the game state to game On!
-  logln("Reset Game Board");
-  FastLED.setBrightness(led_brightness);
+  rng_new_game();
+  Serial.printf("Reset Game Board (seed %u)\n", rngSeedUsed);
+  pixels_set_brightness(led_brightness);
 
-  puckPosition = NUM_LEDS/2; // start in the middle of the strip
-  puckPositionHighRes = puckPosition * 1000; // start in the middle of the strip
+  arena->puckPosition = led_count/2; // start in the middle of the strip
+  arena->puckPositionHighRes = arena->puckPosition * 1000; // start in the middle of the strip
   
-  timeOfStageStart = millis();
-  stage = CALIBRATE;
+  arena->timeOfStageStart = millis();
+  arena->stage = CALIBRATE;
 }
 
 void die()
@@ -265,23 +344,23 @@ void die()
   // -- Puck explodes signaling one side won 
   for (int p = 0; p < PARTICLE_COUNT; p++)
   {
-    particlePool[p].Spawn(puckPosition);
+    arena->particles[p].Spawn(arena->puckPosition);
   }
-  timeOfStageStart = millis();
-  stage = DEAD;
+  arena->timeOfStageStart = millis();
+  arena->stage = DEAD;
 }
 
 // -------- TICKS & RENDERS ---------
 bool tickStartup(unsigned long millisNow)
 {//called repeatily during startup sequence
-  FastLED.clear();
+  clearFrame();
 
-  int timePassed = millisNow - timeOfStageStart;
+  int timePassed = millisNow - arena->timeOfStageStart;
   SFXFreqSweepWarble(STARTUP_FADE_DUR, timePassed, 40, 400, 20);
   if ( timePassed < STARTUP_WIPEUP_DUR ) // fill to the top with green
   {
     //logln("Startup Stage1");
-    int n = map(((millisNow - timeOfStageStart)), 0, STARTUP_WIPEUP_DUR, 0, NUM_LEDS); // fill from top to bottom
+    int n = map(((millisNow - arena->timeOfStageStart)), 0, STARTUP_WIPEUP_DUR, 0, led_count - 1); // fill from top to bottom
     for (int i = 0; i <= n; i++)
     {
       leds[i] = CRGB(0, 255, 0);
@@ -290,13 +369,15 @@ bool tickStartup(unsigned long millisNow)
   else if ( timePassed < STARTUP_SPARKLE_DUR ) // sparkle the full green bar
   {
     //logln("Startup Stage2");
-    for (int i = 0; i < NUM_LEDS; i++)
+    static uint8_t sparkle[NUM_LEDS];
+    rng_fill(RNG_EFFECTS, sparkle, led_count);
+    for (int i = 0; i < led_count; i++)
     {
-      if (random8(30) < 28)
+      if (rngScale(sparkle[i], 30) < 28)
         leds[i] = CRGB(0, 255, 0); // most are green
       else
       {
-        int flicker = random8(250);
+        int flicker = rng8(RNG_EFFECTS, 250);
         leds[i] = CRGB(flicker, 150, flicker); // some flicker brighter
       }
     }
@@ -304,9 +385,9 @@ bool tickStartup(unsigned long millisNow)
   else if ( timePassed < STARTUP_FADE_DUR ) // fade it out to bottom
   {
     //logln("Startup Stage3: ");
-    int n = map((millisNow - timeOfStageStart), STARTUP_SPARKLE_DUR, STARTUP_FADE_DUR, 0, NUM_LEDS); // fill from top to bottom
+    int n = map((millisNow - arena->timeOfStageStart), STARTUP_SPARKLE_DUR, STARTUP_FADE_DUR, 0, led_count - 1); // fill from top to bottom
     logln(n);
-    int brightness = _max(map((millisNow - timeOfStageStart), STARTUP_SPARKLE_DUR, STARTUP_FADE_DUR, 255, 0), 0);
+    int brightness = _max(map((millisNow - arena->timeOfStageStart), STARTUP_SPARKLE_DUR, STARTUP_FADE_DUR, 255, 0), 0);
     for(int i = 0; i<= n; i++)
     {
       leds[i] = CRGB(0, brightness, 0);
@@ -322,7 +403,7 @@ bool tickStartup(unsigned long millisNow)
 
 void tickCalibrate(unsigned long millisNow)
 {//called here repeatily before game starts
-  FastLED.clear();
+  clearFrame();
   //we want to check the headsets are connected and working
   //if both are working - take some samples and average them
 
@@ -335,7 +416,7 @@ void tickCalibrate(unsigned long millisNow)
     //int nQ = map(qA, 0, 100, 0, NUM_LEDS/2); // bar graph from 0 to max half of the strip
 
     //int nQ = map(brainA.getAverage(), 0, 100, 0, NUM_LEDS/2); // bar graph from 0 to max half of the strip
-    int nQ = map(brainA.attention, 0, 100, 0, NUM_LEDS/2); // bar graph from 0 to max half of the strip
+    int nQ = map(brainA.attention, 0, 100, 0, led_count/2); // bar graph from 0 to max half of the strip
     //Serial.print(brainA.getAverage()); Serial.print(" ");
     //Serial.printf("{%d} ",nQ);
     
@@ -354,23 +435,22 @@ void tickCalibrate(unsigned long millisNow)
     //loglnf("Brain B signal quality: %d\n", qB);
     //int nQ = map(qB, 0, 100, 0, NUM_LEDS/2); // bar graph from 0 to max half of the strip
     
-    int nQ = map(brainB.getAverage(), 0, 100, 0, NUM_LEDS/2); // bar graph from 0 to max half of the strip
+    int nQ = map(brainB.getAverage(), 0, 100, 0, led_count/2); // bar graph from 0 to max half of the strip
 
-    for (int i = NUM_LEDS-1; i >= (NUM_LEDS - nQ); i--)
+    for (int i = led_count-1; i >= (led_count - nQ); i--)
     {
       leds[i] = brainB.signalQuality > 100 ? CRGB(255, 0, 0) : CRGB(0, 0, 255);
     }
   }*/
 
   //if both are working - we can calibrate
-  static unsigned long timeStartedCalibrated = -1;
-  if (brainA.signalQuality == 0 && brainB.signalQuality == 0)
+  if (presence_both_good(arena->index))
   {//Great - both brains are working - calibrate
     //we have option to calibrate here - take some samples and subtract when in play - but it doesnt play well.
     //So we will keep this as a countdown to game start only.
-    if (timeStartedCalibrated == -1)
+    if (arena->timeStartedCalibrated == -1)
     {//start calibrate
-      timeStartedCalibrated = millisNow; //start the calibration timer
+      arena->timeStartedCalibrated = millisNow; //start the calibration timer
       logln("Both brains are working, starting calibration");
       //playerA_avg.clear(); playerB_avg.clear();
     }
@@ -379,45 +459,45 @@ void tickCalibrate(unsigned long millisNow)
       //do averaging here
       //playerA_avg.add(brainA.attention); playerB_avg.add(brainB.attention);
 
-      int timePassed = millisNow - timeStartedCalibrated;
+      int timePassed = millisNow - arena->timeStartedCalibrated;
 
       //a count down 3..2..1
-      int calibrateProgress = map(timePassed, 0, CALIBRATE_TIMEOUT, 6, 0);
-      int lpos = calibrateProgress * 6;
-      leds[(NUM_LEDS/2) + lpos] = CRGB(255, 255, 255); // show countdown on the strip
-      leds[(NUM_LEDS/2) + lpos-1] = CRGB(255, 255, 255); // show countdown on the strip
-      leds[(NUM_LEDS/2) - lpos] = CRGB(255, 255, 255); // show countdown on the strip
-      leds[(NUM_LEDS/2) - lpos+1] = CRGB(255, 255, 255); // show countdown on the strip
+      int calibrateProgress = constrain(map(timePassed, 0, calibrateTimeout, COUNTDOWN_STEPS, 0), 0, COUNTDOWN_STEPS);
+      int lpos = calibrateProgress * COUNTDOWN_SPACING; // fits - see the static_asserts in config.h
+      leds[(led_count/2) + lpos] = CRGB(255, 255, 255); // show countdown on the strip
+      leds[(led_count/2) + lpos-1] = CRGB(255, 255, 255); // show countdown on the strip
+      leds[(led_count/2) - lpos] = CRGB(255, 255, 255); // show countdown on the strip
+      leds[(led_count/2) - lpos+1] = CRGB(255, 255, 255); // show countdown on the strip
 
       //_._._.__
       SFXRaceStart(calibrateProgress);
 
-      if (CALIBRATE_TIMEOUT < timePassed)
+      if (calibrateTimeout < timePassed)
       {
-        playerA_Cal = brainA.getAverage();
-        playerB_Cal = brainB.getAverage();
+        arena->playerA_Cal = arena->brainA->getAverage();
+        arena->playerB_Cal = arena->brainB->getAverage();
         //Serial.printf("Calibrated OK - A: %d, B: %d\n", playerA_Cal, playerB_Cal);
         logln("Calibrated OK");
-        stage = PLAY; //go to play stage
-        timeStartedCalibrated = -1; //so next time we start calibrating again
+        arena->stage = PLAY; //go to play stage
+        arena->timeStartedCalibrated = -1; //so next time we start calibrating again
       }
     }
   }
   else
   {
-    if (timeStartedCalibrated == -1)
+    if (arena->timeStartedCalibrated == -1)
     {// if either headset is not being worn - do demo where show the current power of one headset
       //logln("Waiting for both brains to be connected and working");
       soundOff(); //stop any sounds
      
       //A(headset 1) is on the left side of the strip (entry point to strip)
-      int nQA = map(brainA.getAverage(), 0, 100, 0, NUM_LEDS/2); // bar graph from 0 to max half of the strip
+      int nQA = map(arena->brainA->getAverage(), 0, 100, 0, led_count/2); // bar graph from 0 to max half of the strip
       for (int i = 0; i <= nQA; i++)
       {
-        if (brainA.signalQualityNotEstimated == 0){
+        if (arena->brainA->signalQualityNotEstimated == 0){
           leds[i] = CRGB(0, 255, 0); //perfect connection
         }
-        else if (brainA.signalQualityNotEstimated < 30){
+        else if (arena->brainA->signalQualityNotEstimated < 30){
           leds[i] = CRGB(255/4, 165/4, 0);
         }
         else
@@ -427,13 +507,13 @@ void tickCalibrate(unsigned long millisNow)
       }
   
       //B(headset 2) is on the right side of the strip (far from Esp32)
-      int nQB = map(brainB.getAverage(), 0, 100, 0, NUM_LEDS/2); // bar graph from 0 to max half of the strip
-      for (int i = NUM_LEDS-1; i >= (NUM_LEDS - nQB); i--)
+      int nQB = map(arena->brainB->getAverage(), 0, 100, 0, led_count/2); // bar graph from 0 to max half of the strip
+      for (int i = led_count-1; i >= (led_count - nQB); i--)
       {
-        if (brainB.signalQualityNotEstimated == 0){
+        if (arena->brainB->signalQualityNotEstimated == 0){
           leds[i] = CRGB(0, 255, 0); //perfect connection
         }
-        else if (brainB.signalQualityNotEstimated < 30){
+        else if (arena->brainB->signalQualityNotEstimated < 30){
           leds[i] = CRGB(255/4, 165/4, 0);
         }
         else
@@ -443,7 +523,7 @@ void tickCalibrate(unsigned long millisNow)
     }
     else{
       logln("Oops - lost a brain - restart calibration");
-      timeStartedCalibrated = -1;
+      arena->timeStartedCalibrated = -1;
     }
   }
 }
@@ -451,43 +531,45 @@ void tickCalibrate(unsigned long millisNow)
 
 void drawPlayers()
 {
-  int lenA = playerA/6; //bar will be max 1/6 of the 100
-  int lenB = playerB/6;
+  int lenA = arena->playerA/6; //bar will be max 1/6 of the 100
+  int lenB = arena->playerB/6;
 
-  for (int i = puckPosition + 1; i <= (puckPosition + lenA - 1); i++)
+  for (int i = arena->puckPosition + 1; i <= (arena->puckPosition + lenA - 1); i++)
   {
-    if (i>=0 && i<NUM_LEDS)
-      leds[i] = PLAYER_COLOUR_A; // Player A orange drawn toward Player B
+    if (i>=0 && i<led_count)
+      layerSet(LAYER_PLAYERS, i, PLAYER_COLOUR_A); // Player A orange drawn toward Player B
   }
-  for (int i = puckPosition - 1; i >= (puckPosition - lenB + 1); i--)
+  for (int i = arena->puckPosition - 1; i >= (arena->puckPosition - lenB + 1); i--)
   {
-    if (i>=0 && i<NUM_LEDS)
-      leds[i] = PLAYER_COLOUR_B; // Player B (green) drawn toward Player A
+    if (i>=0 && i<led_count)
+      layerSet(LAYER_PLAYERS, i, PLAYER_COLOUR_B); // Player B (green) drawn toward Player A
   }
 
   if (lenA>lenB){
-    puckPositionHighRes+=200;
+    arena->puckPositionHighRes+=200;
     if (lenA>(lenB+lenB))
-      puckPositionHighRes+=100; //A is dominating
+      arena->puckPositionHighRes+=100; //A is dominating
   }
   if (lenA<lenB){
-    puckPositionHighRes-=200;
+    arena->puckPositionHighRes-=200;
     if (lenB>(lenA+lenA))
-      puckPositionHighRes-=100; //B is dominating
+      arena->puckPositionHighRes-=100; //B is dominating
   }
 
-  puckPositionHighRes = constrain(puckPositionHighRes, 0, (NUM_LEDS*1000)); // don't let puckPosition go above VIRTUAL_LED_COUNT
+  arena->puckPositionHighRes = constrain(arena->puckPositionHighRes, 0, (led_count*1000)); // don't let puckPosition go above VIRTUAL_LED_COUNT
 
-  puckPosition = puckPositionHighRes/1000;
-  puckPosition = constrain(puckPosition, 0, NUM_LEDS-1); // don't let puckPosition go above LED_COUNT
+  arena->puckPosition = arena->puckPositionHighRes/1000;
+  arena->puckPosition = constrain(arena->puckPosition, 0, led_count-1); // don't let puckPosition go above LED_COUNT
 
   #ifdef VERBOSE
-  printf("Player A: %d, Player B: %d, Player: %d, puckPositionHighRes: %d\n", playerA, playerB, puckPosition, puckPositionHighRes);
+  printf("Player A: %d, Player B: %d, Player: %d, puckPositionHighRes: %d\n", arena->playerA, arena->playerB, arena->puckPosition, arena->puckPositionHighRes);
   #endif
 
-  leds[puckPosition] = CRGB(155, 0, 0);
+  layerSet(LAYER_PUCK, arena->puckPosition, CRGB(155, 0, 0));
+  if (arena->index == 0)
+    latency_puck();
 
-  if (puckPosition <5 || puckPosition > (NUM_LEDS - 6))
+  if (arena->puckPosition <5 || arena->puckPosition > (led_count - 6))
   {
     die();
   }
@@ -495,8 +577,8 @@ void drawPlayers()
 
 void drawExit()
 {
-  leds[0] = CRGB(255, 0, 0);
-  leds[NUM_LEDS - 1] = CRGB(255, 0, 0); // exit is red
+  layerSet(LAYER_OVERLAY, 0, CRGB(255, 0, 0));
+  layerSet(LAYER_OVERLAY, led_count - 1, CRGB(255, 0, 0)); // exit is red
 }
 
 bool tickParticles()
@@ -506,18 +588,18 @@ bool tickParticles()
   int stillAlive = 0;
   for (int p = 0; p < PARTICLE_COUNT; p++)
   {
-    if (particlePool[p].Alive())
+    if (arena->particles[p].Alive())
     {
       stillAlive++;
-      particlePool[p].Tick();
+      arena->particles[p].Tick();
 
-      if (particlePool[p]._power < 5)
+      if (arena->particles[p]._power < 5)
       {
-        brightness = (5 - particlePool[p]._power) * 10;
-        leds[particlePool[p]._posLed] += CRGB(brightness, brightness / 2, brightness / 2);
+        brightness = (5 - arena->particles[p]._power) * 10;
+        layerSet(LAYER_PARTICLES, arena->particles[p]._posLed, CRGB(brightness, brightness / 2, brightness / 2));
       }
       else
-        leds[particlePool[p]._posLed] += CRGB(particlePool[p]._power, 0, 0);
+        layerSet(LAYER_PARTICLES, arena->particles[p]._posLed, CRGB(arena->particles[p]._power, 0, 0));
 
       stillActive = true;
     }
@@ -531,22 +613,22 @@ void tickDie(long millisNow)
   #define duration 200      // milliseconds
   const int width = 20;     // half width of the explosion
 
-  int timePassed = millisNow - timeOfStageStart;
+  int timePassed = millisNow - arena->timeOfStageStart;
   if (timePassed < duration)
   { // Spread red from player position up and down the width
 
     int brightness = map(timePassed, 0, duration, 255, 150); // this allows a fade from white to red
 
     // fill up
-    int n = constrain(map(timePassed, 0, duration, puckPosition, puckPosition + width), 0, NUM_LEDS - 1);
-    for (int i = puckPosition; i <= n; i++)
+    int n = constrain(map(timePassed, 0, duration, arena->puckPosition, arena->puckPosition + width), 0, led_count - 1);
+    for (int i = arena->puckPosition; i <= n; i++)
     {
       leds[i] = CRGB(255, brightness, brightness);
     }
 
     // fill to down
-    n = constrain(map(timePassed, 0, duration, puckPosition, puckPosition - width), 0, NUM_LEDS - 1);
-    for (int i = puckPosition; i >= n; i--)
+    n = constrain(map(timePassed, 0, duration, arena->puckPosition, arena->puckPosition - width), 0, led_count - 1);
+    for (int i = arena->puckPosition; i >= n; i--)
     {
       leds[i] = CRGB(255, brightness, brightness);
     }
@@ -579,40 +661,161 @@ void screenSaverTick()
     random_LED_flashes();
 }
 
+// --------- TEST SCENES -----------
+/** renderTestScene()
+ *  Draws one fixed scene (into leds[] and the compositor layers) for the "frames test" golden checks (see framecap.h).
+ *  Times, player values and random seeds are all fixed so a scene always draws the same frame.
+ *  The calibrate scenes use two test headsets and set the presence states; the screensavers run
+ *  on the effect clock (effect_millis() - FastLED's beatsin16 reads it as GET_MILLIS), held at
+ *  fixed times. New scenes go on the end, so goldens saved before them still match.
+ *  Returns false when there are no more scenes. The arena (stage, players, puck, strip, particles),
+ *  the random streams, the arena's presence states and the frame interval are saved before the
+ *  first scene and put back after the last, so a test run in the middle of a game leaves the
+ *  game where it was.
+ */
+static Arena testSceneSaved;
+static uint32_t testSceneRng[RNG_STREAMS];
+static uint32_t testSceneSeed;
+static Presence testScenePresence[2];
+static uint32_t testSceneInterval;
+static Brain testBrainA("tA"), testBrainB("tB");   // the calibrate bar graphs' headsets
+
+// a headset with a poor signal - its attention is estimated, which is what the bar graph shows
+static void testSceneHeadset(Brain& b, uint8_t quality, uint8_t shownQuality)
+{
+  BrainPacket p = {};
+  p.fields = BRAIN_HAS_QUALITY | BRAIN_HAS_ATTENTION | BRAIN_HAS_POWER;
+  p.signalQuality = quality;
+  for (int i = 0; i < EEG_POWER_BANDS; i++)
+    p.eegPower[i] = 20000 + i * 7000;
+  b.consume(p);
+  b.signalQualityNotEstimated = shownQuality; // the colour of the bar
+}
+
+// an attract effect, 20 frames up to 'ms' at the full frame rate - the trails build up as they would
+static void testSceneEffect(void (*effect)(), unsigned long ms)
+{
+  rng_seed(99);
+  effectHue = 0;
+  for (int f = 19; f >= 0; f--)
+  {
+    effectClockMs = ms - f * (FRAME_INTERVAL_US / 1000);
+    effect();
+    if (f > 0)
+      compositor_flatten(); // the last frame is flattened by the caller (framecap.h)
+  }
+  effectClockMs = 0;
+}
+
+bool renderTestScene(int scene)
+{
+  if (scene == 0)
+  {
+    testSceneSaved = *arena;
+    memcpy(testSceneRng, rngState, sizeof(rngState));
+    testSceneSeed = rngSeedUsed;
+    testScenePresence[0] = presence[2 * arena->index].state;
+    testScenePresence[1] = presence[2 * arena->index + 1].state;
+    testSceneInterval = frameIntervalUs;
+    frameIntervalUs = FRAME_INTERVAL_US; // the effects scale their steps by it (screensavers.h)
+  }
+  fill_solid(leds, NUM_LEDS, CRGB::Black);
+
+  switch (scene)
+  {
+    case 0: // startup - wipe up
+      arena->timeOfStageStart = 0;
+      tickStartup(100);
+      return true;
+    case 1: // startup - sparkle
+      arena->timeOfStageStart = 0;
+      rng_seed(1234);
+      tickStartup(700);
+      return true;
+    case 2: // startup - fade out
+      arena->timeOfStageStart = 0;
+      tickStartup(1400);
+      return true;
+    case 3: // play - A pulling harder than B
+      arena->playerA = 60;
+      arena->playerB = 30;
+      arena->puckPosition = led_count/2;
+      arena->puckPositionHighRes = arena->puckPosition * 1000;
+      drawPlayers();
+      drawExit();
+      return true;
+    case 4: // explosion
+      arena->puckPosition = led_count/2;
+      rng_seed(42);
+      die();
+      arena->timeOfStageStart = 0;
+      tickDie(100);
+      tickParticles();
+      return true;
+    case 5: // particles half a second after the explosion
+      for (int i = 0; i < 30; i++)
+      {
+        clearFrame();
+        tickParticles();
+        compositor_flatten();
+      }
+      return true;
+    case 6: // calibrate - one headset off: A's bar with a good signal, B's with a poor one
+      arena->brainA = &testBrainA;
+      arena->brainB = &testBrainB;
+      testSceneHeadset(testBrainA, 20, 0);
+      testSceneHeadset(testBrainB, 40, 20);
+      presence[2 * arena->index].state = PRESENCE_GOOD;
+      presence[2 * arena->index + 1].state = PRESENCE_UNPLUGGED;
+      arena->timeStartedCalibrated = -1;
+      tickCalibrate(1000);
+      return true;
+    case 7: // calibrate - both on, a second into the countdown
+      presence[2 * arena->index].state = PRESENCE_GOOD;
+      presence[2 * arena->index + 1].state = PRESENCE_GOOD;
+      arena->timeStartedCalibrated = 0;
+      tickCalibrate(1000);
+      return true;
+    case 8: // screensavers - 10 s in, on the stopped effect clock
+      testSceneEffect(juggle, 10000);
+      return true;
+    case 9:
+      testSceneEffect(sinelon, 10000);
+      return true;
+    case 10:
+      testSceneEffect(random_LED_flashes, 10000);
+      return true;
+    case 11:
+      testSceneEffect(LED_march, 10000);
+      return true;
+  }
+
+  // done - put the game back the way it was (the explosion's sound can't be, so it stops)
+  *arena = testSceneSaved;
+  memcpy(rngState, testSceneRng, sizeof(rngState));
+  rngSeedUsed = testSceneSeed;
+  presence[2 * arena->index].state = testScenePresence[0];
+  presence[2 * arena->index + 1].state = testScenePresence[1];
+  frameIntervalUs = testSceneInterval;
+  soundOff();
+  return false;
+}
+
 void displayTick()
 {
-  if (stage == SCREENSAVER)
+  unsigned long millisNow = millis();
+  if (arena->stage == SCREENSAVER)
   {
     //only do this in screensaver mode
-    // Timing constants
-    const unsigned long fadeTime1 = 1000;  // 1 second for LED1
-    const unsigned long fadeTime2 = 1500;  // 1.5 seconds for LED2
-
-    // Get current time
-    unsigned long currentTime = millis();
-    
-    // Calculate brightness for LED1 (1-second cycle)
-    float phase1 = (currentTime % fadeTime1) / (float)fadeTime1;
-    int brightness1 = (sin(phase1 * TWO_PI) * 127.5 + 127.5);  // Sine wave from 0 to 255
-    
-    // Calculate brightness for LED2 (1.5-second cycle, out of phase)
-    float phase2 = ((currentTime % fadeTime2) / (float)fadeTime2 + 0.5);  // Offset by 180 degrees
-    if (phase2 > 1.0) phase2 -= 1.0;
-    int brightness2 = (sin(phase2 * TWO_PI) * 127.5 + 127.5);  // Sine wave from 0 to 255
-    
-    // Write brightness to LEDs
-    analogWrite(led1Pin, brightness1);
-    analogWrite(led2Pin, brightness2);
+    // swing the needles - 1 second for LED1, 1.5 seconds for LED2, out of phase
+    meter_pulse(0, 1000, millisNow);
+    meter_pulse(1, 1500, millisNow);
   }
   else{
     //display the scores on the display
-    //player A on left, player B on right
-    //map 0..PLAYERMAX to 0..255 for PWM
-    int dispA = constrain(map(playerA, 0, PLAYERMAX, 0, 255), 0, 255);
-    int dispB = constrain(map(playerB, 0, PLAYERMAX, 0, 255), 0, 255);
-
-    analogWrite(led1Pin, dispA); // left side display
-    analogWrite(led2Pin, dispB); // right side display
+    //player A on left, player B on right - the LEDC fades to each new value
+    meter_set(0, arena->playerA, millisNow); // left side display
+    meter_set(1, arena->playerB, millisNow); // right side display
   }
 }
 
@@ -643,13 +846,23 @@ void getInput()
   //playerA_avg.add(brainA.attention);
   //playerB_avg.add(brainB.attention);
 
-  playerA = brainA.getAverage();// - playerA_Cal;
-  playerB = brainB.getAverage();// - playerB_Cal;
+  if (predictInput)
+  {// between packets too - see predictor.h
+    arena->playerA = predict_value(2 * arena->index);
+    arena->playerB = predict_value(2 * arena->index + 1);
+  }
+  else
+  {
+    arena->playerA = arena->brainA->getAverage();// - playerA_Cal;
+    arena->playerB = arena->brainB->getAverage();// - playerB_Cal;
+  }
+  if (arena->index == 0)
+    latency_input(*arena->brainA, *arena->brainB); // the latency trace follows the first arena
 
   //not sure if using calibrations data will be a better game...
   #ifdef VERSION_2
-    playerA -= playerA_Cal;
-    playerB -= playerB_Cal;
+    arena->playerA -= arena->playerA_Cal;
+    arena->playerB -= arena->playerB_Cal;
   #endif
 
   //loglnf("(A)playerA: %d, playerB: %d\n", playerA, playerB);
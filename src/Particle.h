@@ -1,6 +1,8 @@
 #pragma once
 
 #include "Arduino.h"
+#include "config.h"
+#include "rng.h"
 #define FRICTION 1
 
 class Particle
@@ -21,14 +23,16 @@ class Particle
 
 void Particle::Spawn(int pos){
     //_pos = pos;
-    _pos = map(pos, 0, NUM_LEDS - 1,0, 1000);
-    _sp = random(-200, 200);
+    _pos = map(pos, 0, led_count - 1,0, 1000);
+    _sp = rngRange(RNG_PARTICLES, -200, 200);
     _power = 255;
     _alive = 1;
     _life = 220 - abs(_sp);
 }
 
-void Particle::Tick(){
+// whole pool every frame while dead - kept in IRAM, and calls nothing outside it: integer maths
+// only (no map(), no double - soft float on the ESP32), and the same results as those gave
+void IRAM_ATTR Particle::Tick(){
     if(_alive){
         _life ++;
         if(_sp > 0){
@@ -38,9 +42,9 @@ void Particle::Tick(){
         }
         _power = 100 - _life;
         if(_power <= 0){
-            Kill(); 
+            _alive = 0; // Kill()
         }else{
-            _pos += _sp/7.0;
+            _pos = (7*_pos + _sp)/7; // _pos += _sp/7.0, truncated the same way
             if(_pos > 1000){
                 _pos = 1000;
                 _sp = 0-(_sp/2);
@@ -51,7 +55,7 @@ void Particle::Tick(){
             }
         }
 
-        _posLed = map(_pos, 0, 1000, 0, NUM_LEDS - 1);
+        _posLed = _pos * (led_count - 1) / 1000; // map(_pos, 0, 1000, 0, led_count - 1)
     }
 }
 
@@ -1,18 +1,18 @@
 #pragma once
 #include <Arduino.h>
 
-template<typename T>
+// CAP samples of storage inside the object (no heap) - the window in use can be set lower
+template<typename T, size_t CAP = 10>
 class RollingAverage {
 public:
-  RollingAverage(size_t capacity = 10) : _cap(capacity), _buf(nullptr), _idx(0), _count(0), _sum(0.0) {
-    if (_cap == 0) _cap = 1;
-    _buf = new T[_cap];
+  RollingAverage(size_t window = CAP) : _win(window), _idx(0), _count(0), _sum(0.0) {
+    if (_win == 0) _win = 1;
+    if (_win > CAP) _win = CAP;
     clear();
   }
-  ~RollingAverage() { delete[] _buf; }
 
   void add(T v) {
-    if (_count < _cap) {
+    if (_count < _win) {
       _buf[_idx] = v;
       _sum += (double)v;
       _count++;
@@ -22,7 +22,7 @@ public:
       _buf[_idx] = v;
       _sum += (double)v;
     }
-    _idx = (_idx + 1) % _cap;
+    _idx = (_idx + 1) % _win;
   }
 
   double getAverage() const {
@@ -31,19 +31,29 @@ public:
   }
 
   void clear() {
-    for (size_t i = 0; i < _cap; ++i) _buf[i] = (T)0;
+    for (size_t i = 0; i < CAP; ++i) _buf[i] = (T)0;
     _idx = 0;
     _count = 0;
     _sum = 0.0;
   }
 
+  // change how many samples are averaged (1..capacity) - history is cleared
+  void setWindow(size_t window) {
+    if (window == 0) window = 1;
+    if (window > CAP) window = CAP;
+    if (window == _win) return;
+    _win = window;
+    clear();
+  }
+
   size_t count() const { return _count; }
-  size_t capacity() const { return _cap; }
+  size_t capacity() const { return CAP; }
+  size_t window() const { return _win; }
 
 private:
-  size_t _cap;
-  T* _buf;
+  T _buf[CAP];
+  size_t _win;
   size_t _idx;
   size_t _count;
   double _sum;
-};
\ No newline at end of file
+};
@@ -0,0 +1,86 @@
+/*
+  Arenas - one tug of war game each: its stage and timers, two players, the puck, the
+  explosion particles and its own strip. A board runs TUG_ARENAS of them (build with
+  -DTUG_ARENAS=2, the [env:twin] environment, for two strips side by side).
+
+  Arena n plays headsets 2n and 2n+1 (serial_ap.h) and drives LED output n (pixels.h).
+  loop() ticks the arenas one after the other each frame - arena_select() points the game
+  code at one: arena, and leds (the strip everything draws into). The compositor layers are
+  only scratch for one frame, so the arenas share them; one FastLED show sends both strips.
+
+  Shared by the arenas, and so following the first one: the speaker (the others are muted -
+  sound.h), the strength meters, the match recorder and the telemetry.
+*/
+#pragma once
+
+#include <Arduino.h>
+#include <FastLED.h>
+#include "config.h"
+#include "Particle.h"
+#include "sound.h"
+
+#define PARTICLE_COUNT 100
+
+enum stages
+{
+  STARTUP,    //startup sequence
+  CALIBRATE, //calibration sequence
+  PLAY,   //playing the game
+  DEAD, //dead sequence
+  SCREENSAVER  // screensaver
+};
+
+class Brain;
+
+struct Arena
+{
+  uint8_t index;
+  stages stage;
+  unsigned long timeOfStageStart;       // Stores the time the current Game Started
+  unsigned long lastInputTime;          // last time there was input
+  unsigned long timeStartedCalibrated;  // -1 = not counting down
+  int playerA, playerB;                 // player power values (0-PLAYERMAX)
+  int playerA_Cal, playerB_Cal;         // average of the player values before the game starts
+  int puckPosition;                     // 0..led_count-1
+  int puckPositionHighRes;              // puckPosition * 1000
+  Brain* brainA;                        // A(headset 1) is on the left side of the strip (entry point to strip)
+  Brain* brainB;
+  CRGB strip[NUM_LEDS];
+  Particle particles[PARTICLE_COUNT];
+};
+
+static Arena arenas[TUG_ARENAS];
+static Arena* arena = &arenas[0];   // the arena being ticked
+CRGB* leds = arenas[0].strip;       // and its strip - what the stages and effects draw into
+
+inline void arena_select(int a)
+{
+  arena = &arenas[a];
+  leds = arena->strip;
+  sound_mute(a != 0); // one speaker - it follows the first arena
+}
+
+/** arena_setup()
+ *  brains - 2 per arena, A then B.
+ */
+void arena_setup(Brain** brains)
+{
+  for (int a = 0; a < TUG_ARENAS; a++)
+  {
+    Arena& ar = arenas[a];
+    ar.index = a;
+    ar.stage = STARTUP;
+    ar.timeOfStageStart = millis();
+    ar.timeStartedCalibrated = -1;
+    ar.brainA = brains[2 * a];
+    ar.brainB = brains[2 * a + 1];
+  }
+  arena_select(0);
+}
+
+// the strip got shorter (settings.h) - switch off the pixels no longer used, on every strip
+void arena_blank_unused(uint16_t from)
+{
+  for (int a = 0; a < TUG_ARENAS; a++)
+    fill_solid(arenas[a].strip + from, NUM_LEDS - from, CRGB::Black);
+}
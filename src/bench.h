@@ -0,0 +1,281 @@
+/*
+  Benchmarks for the hot paths - build with the [env:bench] PlatformIO environment.
+
+  The benchmarks run once when the startup animation is over and can be run again with the
+  "bench" console command. Each one times every iteration with the CPU cycle counter and reports
+  the best, mean and worst cycles per iteration. Results are printed as one JSON object
+  (between the BENCH_BEGIN and BENCH_END lines) so runs from two releases can be diffed.
+  After the timings, "pixels_vs_fastled" counts the colours where pixels_convert()'s bytes
+  differ from FastLED's own scale8() / rgb_2_rgbw() - all zero means the strip gets the
+  same bytes as when FastLED did the conversion (dithering aside - see pixels.h).
+
+  tools/hostbench runs the input and particle benchmarks on the host, over the same code and
+  with the same JSON ("target": "host") - for timing a change before it goes on a board.
+
+  Note: the benchmarks use the game's own state (the arenas' strips, particles, players, sound)
+  so the games are reset when they finish. "arenas_frame" is a whole frame of every arena
+  playing - compare its worst against frame_us in the header to see if TUG_ARENAS fits.
+*/
+#pragma once
+
+#include <Arduino.h>
+#include <FastLED.h>
+#include "config.h"
+#include "pixels.h"
+#include "Brain.h"
+#include "RollingAverage.h"
+#include "particle.h"
+#include "rng.h"
+#include "fixmath.h"
+#include "meters.h"
+#include "boot.h"
+#include "screensavers.h"
+#include "sfx.h"
+#include "settings.h"
+#include "arena.h"
+
+#define BENCH_REPEAT 200     // iterations per benchmark (FastLED.show is fewer - it is slow)
+
+// in ESP32TUG.ino
+void drawPlayers();
+void drawExit();
+bool tickParticles();
+void startAGame();
+
+struct BenchResult
+{
+  uint32_t best;
+  uint32_t worst;
+  uint64_t total;
+  uint32_t count;
+};
+
+static bool benchFirst = true;
+
+void benchBegin(BenchResult& r)
+{
+  r.best = UINT32_MAX;
+  r.worst = 0;
+  r.total = 0;
+  r.count = 0;
+}
+
+inline void benchAdd(BenchResult& r, uint32_t cycles)
+{
+  if (cycles < r.best) r.best = cycles;
+  if (cycles > r.worst) r.worst = cycles;
+  r.total += cycles;
+  r.count++;
+}
+
+void benchReport(const char* name, const BenchResult& r, const char* unit)
+{
+  uint32_t mean = r.count ? (uint32_t)(r.total / r.count) : 0;
+  uint32_t mhz = getCpuFrequencyMhz();
+  Serial.printf("%s\n    {\"name\": \"%s\", \"unit\": \"%s\", \"iterations\": %u, \"cycles_best\": %u, \"cycles_mean\": %u, \"cycles_worst\": %u, \"ns_mean\": %u}",
+                benchFirst ? "" : ",", name, unit, r.count, r.best, mean, r.worst, (uint32_t)((uint64_t)mean * 1000 / mhz));
+  benchFirst = false;
+}
+
+// times one call of 'body' per iteration
+#define BENCH(name, unit, iterations, body)         \
+  {                                                 \
+    BenchResult r;                                  \
+    benchBegin(r);                                  \
+    for (int it = 0; it < (iterations); it++)       \
+    {                                               \
+      uint32_t t0 = ESP.getCycleCount();            \
+      body;                                         \
+      benchAdd(r, ESP.getCycleCount() - t0);        \
+    }                                               \
+    benchReport(name, r, unit);                     \
+  }
+
+// a typical 1 Hz headset packet - quality, attention, meditation and the eight band powers
+uint8_t benchPacket(uint8_t* buf)
+{
+  uint8_t n = 0;
+  buf[n++] = 0xAA;
+  buf[n++] = 0xAA;
+  buf[n++] = 32;                 // payload length
+  uint8_t* payload = buf + n;
+  payload[0] = 0x02; payload[1] = 0;      // perfect signal - no estimate printed
+  payload[2] = 0x83; payload[3] = 24;
+  for (int i = 0; i < 24; i++)
+    payload[4 + i] = (uint8_t)(i * 37 + 11);
+  payload[28] = 0x04; payload[29] = 55;   // attention
+  payload[30] = 0x05; payload[31] = 40;   // meditation
+  uint8_t sum = 0;
+  for (int i = 0; i < 32; i++)
+    sum += payload[i];
+  n += 32;
+  buf[n++] = 255 - sum;          // checksum
+  return n;
+}
+
+// pixelsConvert() against FastLED's own conversion, on the board with the real library:
+// scale8() for an RGB strip, rgb_2_rgbw() exact colours (what RgbwDefault() selects) for RGBW.
+// Without dithering on both sides - see pixels.h. Every 5th red and green, every blue.
+long benchPixelsVsFastled(uint8_t brightness, bool rgbw, uint32_t& colours)
+{
+  uint8_t lut[256];
+  pixelsBuildLut(lut, brightness, 1.0f);
+  const uint16_t order = variant.colourOrder;
+  const int c0 = (order >> 6) & 7, c1 = (order >> 3) & 7, c2 = order & 7;
+  long bad = 0;
+  colours = 0;
+  for (int r = 0; r < 256; r += 5)
+  {
+    for (int g = 0; g < 256; g += 5)
+      for (int b = 0; b < 256; b++, colours++)
+      {
+        uint8_t in[3] = {(uint8_t)r, (uint8_t)g, (uint8_t)b}, ours[4] = {0}, ref[4] = {0}, v[3];
+        pixelsConvert(lut, in, ours, 1, order, rgbw);
+        if (rgbw)
+          rgb_2_rgbw(kRGBWExactColors, kRGBWDefaultColorTemp, r, g, b, brightness, brightness, brightness,
+                     &v[0], &v[1], &v[2], &ref[3]);
+        else
+          for (int c = 0; c < 3; c++)
+            v[c] = scale8(in[c], brightness);
+        ref[0] = v[c0]; ref[1] = v[c1]; ref[2] = v[c2];
+        bad += memcmp(ours, ref, rgbw ? 4 : 3) != 0;
+      }
+    vTaskDelay(1); // let the other tasks on this core run - this takes a few seconds
+  }
+  return bad;
+}
+
+void bench_run()
+{
+  benchFirst = true;
+  Serial.println("BENCH_BEGIN");
+  Serial.printf("{\"target\": \"esp32\", \"version\": \"%s\", \"cpu_mhz\": %u, \"leds\": %u, \"arenas\": %u, \"frame_us\": %u, ",
+                VERSION, getCpuFrequencyMhz(), led_count, TUG_ARENAS, FRAME_INTERVAL_US);
+  // boot time - us since the app started, per phase (boot.h); 0 = not reached
+  Serial.print("\"boot_us\": {");
+  for (int p = 0; p < BOOT_PHASES; p++)
+    Serial.printf("%s\"%s\": %u", p ? ", " : "", bootPhaseNames[p], bootUs[p]);
+  Serial.print("}, \"results\": [");
+
+  // ---- input ----
+  {
+    static Brain benchBrain("bench");
+    uint8_t packet[40];
+    uint8_t len = benchPacket(packet);
+    int b = 0;
+    BrainPacket queued;
+    // the parser task's side - framing, checksum, fields, queue (emptied between packets, as loop() would)
+    BENCH("brain_update_byte", "byte", BENCH_REPEAT * len,
+          benchBrain.update(packet[b]); b = (b + 1) % len; if (b == 0) benchBrain.nextPacket(queued));
+    BENCH("brain_update_packet", "packet", BENCH_REPEAT,
+          for (int i = 0; i < len; i++) benchBrain.update(packet[i]); benchBrain.nextPacket(queued));
+    BENCH("brain_update_chunk", "packet", BENCH_REPEAT, benchBrain.update(packet, len); benchBrain.nextPacket(queued));
+    // loop()'s side
+    BENCH("brain_consume", "packet", BENCH_REPEAT, benchBrain.consume(queued));
+  }
+  {
+    volatile uint8_t att;
+    uint32_t p = 1000;
+    BENCH("approximate_attention", "call", BENCH_REPEAT,
+          att = approximateAttention(p, p * 2, p * 3, p, p * 5, p * 2, p, p / 2, 20); p += 97);
+  }
+  {
+    RollingAverage<uint8_t, MAX_AVERAGING_LENGTH> avg;
+    avg.setWindow(averagingLength);
+    volatile double a;
+    BENCH("rolling_average_add", "call", BENCH_REPEAT, avg.add((uint8_t)it); a = avg.getAverage());
+  }
+
+  // ---- render ----
+  for (int p = 0; p < PARTICLE_COUNT; p++)
+    arena->particles[p].Spawn(led_count / 2);
+  BENCH("particle_tick_pool", "frame", BENCH_REPEAT,
+        for (int p = 0; p < PARTICLE_COUNT; p++) arena->particles[p].Tick());
+
+  {
+    static uint8_t noise[NUM_LEDS];
+    volatile int32_t r;
+    BENCH("random8_per_pixel", "frame", BENCH_REPEAT,
+          for (int i = 0; i < led_count; i++) noise[i] = random8(20));
+    BENCH("rng_fill_frame", "frame", BENCH_REPEAT,
+          rng_fill(RNG_EFFECTS, noise, led_count); for (int i = 0; i < led_count; i++) noise[i] = rngScale(noise[i], 20));
+    BENCH("arduino_random", "call", BENCH_REPEAT, r = random(-200, 200));
+    BENCH("rng_range", "call", BENCH_REPEAT, r = rngRange(RNG_PARTICLES, -200, 200));
+    BENCH("sin_double", "call", BENCH_REPEAT, r = sin(it / 20.0) * 1000.0);
+    BENCH("sin15", "call", BENCH_REPEAT, r = sin15(phaseAt(it, PHASE_STEP_RAD(20.0))));
+  }
+
+  BENCH("screensaver_juggle", "frame", BENCH_REPEAT, juggle(); compositor_flatten());
+  BENCH("screensaver_sinelon", "frame", BENCH_REPEAT, sinelon(); compositor_flatten());
+  BENCH("screensaver_random_flashes", "frame", BENCH_REPEAT, random_LED_flashes(); compositor_flatten());
+  BENCH("screensaver_fire2012", "frame", BENCH_REPEAT, Fire2012(); compositor_flatten());
+  BENCH("screensaver_led_march", "frame", BENCH_REPEAT, LED_march(); compositor_flatten());
+
+  arena->playerA = arena->playerB = 60; // equal - the puck stays put in the middle
+  BENCH("draw_players", "frame", BENCH_REPEAT,
+        arena->puckPosition = led_count / 2; arena->puckPositionHighRes = arena->puckPosition * 1000; clearFrame(); drawPlayers(); compositor_flatten());
+
+  // ---- sound ----
+  BENCH("sfx_puck_position", "call", BENCH_REPEAT, SFXPuckPosition(it % led_count));
+  BENCH("sfx_freq_sweep_warble", "call", BENCH_REPEAT, SFXFreqSweepWarble(STARTUP_FADE_DUR, it * 7, 40, 400, 20));
+  BENCH("sfx_dead", "call", BENCH_REPEAT, SFXdead());
+  BENCH("meter_set_unchanged", "call", BENCH_REPEAT, meter_set(0, 50, millis()));
+  BENCH("sfx_race_start", "call", BENCH_REPEAT, SFXRaceStart(it % 9));
+  soundOff();
+
+  // ---- output ----
+  BENCH("pixels_convert", "frame", BENCH_REPEAT, pixels_convert());
+  BENCH("fastled_show", "frame", 50, FastLED.show());
+
+  // ---- frame budget ----
+  // every arena mid game with an explosion going - the game side of a frame, then one show
+  for (int a = 0; a < TUG_ARENAS; a++)
+  {
+    arena_select(a);
+    arena->playerA = arena->playerB = 60;
+    for (int p = 0; p < PARTICLE_COUNT; p++)
+      arena->particles[p].Spawn(led_count / 2);
+  }
+  BENCH("arenas_frame", "frame", 50,
+        for (int a = 0; a < TUG_ARENAS; a++) {
+          arena_select(a);
+          arena->puckPosition = led_count / 2; arena->puckPositionHighRes = arena->puckPosition * 1000;
+          clearFrame(); drawPlayers(); drawExit(); tickParticles(); compositor_flatten(); pixels_convert(a);
+        }
+        FastLED.show());
+
+  // ---- pixel bytes against FastLED's own conversion ----
+  Serial.print("\n], \"pixels_vs_fastled\": [");
+  bool firstCheck = true;
+  for (int brightness : {255, 150, 100, 64, 1})
+    for (bool rgbw : {true, false})
+    {
+      uint32_t colours;
+      long bad = benchPixelsVsFastled(brightness, rgbw, colours);
+      Serial.printf("%s\n    {\"brightness\": %d, \"rgbw\": %s, \"colours\": %u, \"mismatches\": %ld}",
+                    firstCheck ? "" : ",", brightness, rgbw ? "true" : "false", colours, bad);
+      firstCheck = false;
+    }
+
+  Serial.println("\n]}");
+  Serial.println("BENCH_END");
+
+  for (int a = 0; a < TUG_ARENAS; a++)
+  {
+    arena_select(a);
+    for (int p = 0; p < PARTICLE_COUNT; p++)
+      arena->particles[p].Kill();
+    startAGame();
+  }
+  arena_select(0);
+}
+
+void benchCommand(char* arg1, char* arg2)
+{
+  bench_run();
+}
+
+void bench_setup()
+{
+  console_add("bench", benchCommand);
+}
@@ -0,0 +1,118 @@
+/*
+  Boot profile and the fast boot path.
+
+  boot_mark() stamps each boot phase with esp_timer_get_time() - microseconds since the app
+  started (the ROM and 2nd stage bootloader, roughly 300 ms before that, are not counted).
+  When the game is ready for play the whole profile is logged once; "boot" on the serial
+  console prints it again, and the bench build puts it in the BENCH output.
+
+  To get from reset to a playable game quickly:
+    - the slow steps nothing else waits for (mounting LittleFS for the recorder - seconds
+      when it has to format - and bringing up WiFi for telemetry) run on a Boot task on
+      core 0 while setup() carries on and the first frames go out
+    - the headset UARTs start before the LEDs, so the SerialAB task is already reading
+      while the startup animation plays. It no longer blocks setup() for the UART
+      drivers to settle - the task waits for that itself
+    - the startup animation is cut short after the wipe if a headset already has contact,
+      so a unit power cycled in the middle of a show goes straight back to the game
+*/
+#pragma once
+
+#include <Arduino.h>
+#include <esp_timer.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include "config.h"
+#include "settings.h"
+#include "tasks.h"
+#include "recorder.h"
+#include "telemetry.h"
+
+enum BootPhase
+{
+  BOOT_SETUP,         // setup() entered
+  BOOT_SETTINGS,      // settings loaded from NVS
+  BOOT_HEADSETS,      // UARTs open, SerialAB task reading
+  BOOT_PIXELS,        // FastLED and the show task
+  BOOT_SOUND,         // DAC and the sound timer
+  BOOT_METERS,        // LEDC meters
+  BOOT_LOOP,          // frame timer started - setup() done
+  BOOT_FIRST_FRAME,   // first frame shown
+  BOOT_STORAGE,       // Boot task done - LittleFS mounted, WiFi started
+  BOOT_READY,         // startup animation over - ready for play
+  BOOT_PHASES
+};
+
+const char* bootPhaseNames[BOOT_PHASES] = {
+  "setup", "settings", "headsets", "pixels", "sound", "meters", "loop", "first_frame", "storage", "ready",
+};
+
+static volatile uint32_t bootUs[BOOT_PHASES];   // 0 = not reached yet
+static TaskHandle_t bootTaskHandle = NULL;
+
+/** boot_mark()
+ *  Stamp a phase - only the first time, so it can be called every frame.
+ */
+inline void boot_mark(BootPhase p)
+{
+  if (bootUs[p] == 0)
+    bootUs[p] = (uint32_t)esp_timer_get_time();
+}
+
+inline bool boot_reached(BootPhase p)
+{
+  return bootUs[p] != 0;
+}
+
+void bootPrint()
+{
+  uint32_t last = 0;
+  for (int p = 0; p < BOOT_PHASES; p++)
+  {
+    if (bootUs[p] == 0)
+      Serial.printf("  %-12s      -\n", bootPhaseNames[p]);
+    else
+    {
+      // phases are listed in the order they are expected; the Boot task's may come out of turn
+      Serial.printf("  %-12s %6u us  (+%d)\n", bootPhaseNames[p], bootUs[p], (int32_t)(bootUs[p] - last));
+      last = bootUs[p];
+    }
+  }
+}
+
+void bootCommand(char* arg1, char* arg2)
+{
+  Serial.println("boot phases - us since the app started");
+  bootPrint();
+}
+
+/** boot_ready()
+ *  The startup animation is over. Logs the profile the first time.
+ */
+void boot_ready()
+{
+  if (boot_reached(BOOT_READY))
+    return;
+  boot_mark(BOOT_READY);
+  Serial.printf("boot: first frame %u ms, ready for play %u ms\n",
+                bootUs[BOOT_FIRST_FRAME] / 1000, bootUs[BOOT_READY] / 1000);
+  bootPrint();
+}
+
+void bootTask(void* pvParameters)
+{
+  recorder_setup();
+  telemetry_setup();
+  boot_mark(BOOT_STORAGE);
+  bootTaskHandle = NULL;
+  vTaskDelete(NULL);
+}
+
+/** boot_setup()
+ *  Call straight after settings_setup() - the Boot task's modules read the settings.
+ */
+void boot_setup()
+{
+  console_add("boot", bootCommand);
+  task_create(bootTask, "Boot", TASK_BOOT, &bootTaskHandle);
+}
@@ -0,0 +1,173 @@
+/*
+  Frame compositor - draws the frame in layers and merges them into leds[] in one pass.
+
+  leds[] is the background layer (the stage code and the screensavers still draw it directly).
+  Everything drawn on top goes into a layer instead, and compositor_flatten() - once per frame,
+  just before the show - runs over the strip a single time: fades the background if a fade was
+  asked for, then blends each layer on in order:
+
+    background (leds[])  -> fade (compositor_fade)
+    LAYER_EFFECTS        MAX      screensaver dots (was leds[i] |= ...)
+    LAYER_PLAYERS        REPLACE  player bars
+    LAYER_PUCK           REPLACE  the puck
+    LAYER_PARTICLES      ADD      explosion particles, glowing dots (was leds[i] += ...)
+    LAYER_OVERLAY        REPLACE  exits, debug pixel
+
+  Pixels are held packed as 0x00RRGGBB so the blends work on all three channels at once
+  (saturating add, max and scale in plain 32 bit integer ops). Black is "nothing drawn" for
+  the REPLACE layers. Each layer remembers the span it was drawn in, so only that span is
+  blended, and cleared as it is blended - an unused layer costs nothing.
+*/
+#pragma once
+
+#include <Arduino.h>
+#include <FastLED.h>
+#include "config.h"
+
+extern CRGB* leds;   // the strip being drawn (arena.h)
+
+enum Layer
+{
+  LAYER_EFFECTS,
+  LAYER_PLAYERS,
+  LAYER_PUCK,
+  LAYER_PARTICLES,
+  LAYER_OVERLAY,
+  LAYER_COUNT
+};
+
+enum Blend { BLEND_REPLACE, BLEND_ADD, BLEND_MAX };
+
+const Blend layerBlend[LAYER_COUNT] = {BLEND_MAX, BLEND_REPLACE, BLEND_REPLACE, BLEND_ADD, BLEND_REPLACE};
+
+static uint32_t layerPx[LAYER_COUNT][NUM_LEDS];
+static int16_t layerLo[LAYER_COUNT];   // span drawn this frame (only if the layer is used)
+static int16_t layerHi[LAYER_COUNT];
+static uint8_t layerUsed = 0;          // bit per layer
+static uint8_t backgroundScale = 255;  // 255 = no fade
+
+// -------- packed pixel kernels - 0x00RRGGBB ---------
+#define SWAR_HIGH 0x00808080u
+
+inline uint32_t swarPack(const CRGB& c)
+{
+  return ((uint32_t)c.r << 16) | ((uint32_t)c.g << 8) | c.b;
+}
+
+inline CRGB swarUnpack(uint32_t p)
+{
+  return CRGB((uint8_t)(p >> 16), (uint8_t)(p >> 8), (uint8_t)p);
+}
+
+// per channel min(a + b, 255)
+inline uint32_t swarAddSat(uint32_t a, uint32_t b)
+{
+  uint32_t low = (a & ~SWAR_HIGH) + (b & ~SWAR_HIGH);            // low 7 bits - can't cross channels
+  uint32_t carry = ((a & b) | ((a | b) & low)) & SWAR_HIGH;      // carry out of each channel
+  uint32_t sum = low ^ ((a ^ b) & SWAR_HIGH);
+  return sum | ((carry >> 7) * 0xFF);                             // overflowed channels -> 255
+}
+
+// per channel max(a - b, 0)
+inline uint32_t swarSubSat(uint32_t a, uint32_t b)
+{
+  uint32_t diff = ((a | SWAR_HIGH) - (b & ~SWAR_HIGH)) ^ ((a ^ ~b) & SWAR_HIGH);
+  uint32_t borrow = ((~a & b) | (~(a ^ b) & diff)) & SWAR_HIGH;   // a < b in that channel
+  return diff & ~((borrow >> 7) * 0xFF) & 0x00FFFFFF;
+}
+
+// per channel max(a, b)
+inline uint32_t swarMax(uint32_t a, uint32_t b)
+{
+  return b + swarSubSat(a, b);
+}
+
+// per channel (x * (scale + 1)) >> 8 - the same as FastLED's nscale8
+inline uint32_t swarScale(uint32_t p, uint8_t scale)
+{
+  uint32_t s = (uint32_t)scale + 1;
+  uint32_t rb = (((p & 0x00FF00FF) * s) >> 8) & 0x00FF00FF;
+  uint32_t g = (((p & 0x0000FF00) * s) >> 8) & 0x0000FF00;
+  return rb | g;
+}
+
+// -------- drawing ---------
+inline void layerMark(Layer l, int i)
+{
+  if (!(layerUsed & (1 << l)))
+  {
+    layerUsed |= 1 << l;
+    layerLo[l] = layerHi[l] = i;
+  }
+  else if (i < layerLo[l])
+    layerLo[l] = i;
+  else if (i > layerHi[l])
+    layerHi[l] = i;
+}
+
+// draw a pixel on a layer - the layer's blend mode decides how it combines with what is below
+inline void layerSet(Layer l, int i, const CRGB& c)
+{
+  if (i < 0 || i >= led_count)
+    return;
+  uint32_t p = swarPack(c);
+  layerMark(l, i);
+  // pixels drawn twice on one layer combine the same way the layer blends
+  if (layerBlend[l] == BLEND_ADD)
+    layerPx[l][i] = swarAddSat(layerPx[l][i], p);
+  else if (layerBlend[l] == BLEND_MAX)
+    layerPx[l][i] = swarMax(layerPx[l][i], p);
+  else
+    layerPx[l][i] = p;
+}
+
+// fade the background while flattening this frame (like fadeToBlackBy(leds, led_count, 255 - scale))
+inline void compositor_fade(uint8_t scale)
+{
+  backgroundScale = scale;
+}
+
+/** compositor_flatten()
+ *  Merge the layers into leds[] - once per frame, when everything is drawn.
+ */
+void compositor_flatten()
+{
+  int lo = led_count, hi = -1;
+  if (backgroundScale != 255)
+  {
+    lo = 0;
+    hi = led_count - 1;
+  }
+  for (int l = 0; l < LAYER_COUNT; l++)
+  {
+    if (layerUsed & (1 << l))
+    {
+      lo = min(lo, (int)layerLo[l]);
+      hi = max(hi, (int)layerHi[l]);
+    }
+  }
+
+  for (int i = lo; i <= hi; i++)
+  {
+    uint32_t p = swarPack(leds[i]);
+    if (backgroundScale != 255)
+      p = swarScale(p, backgroundScale);
+    for (int l = 0; l < LAYER_COUNT; l++)
+    {
+      if (!(layerUsed & (1 << l)) || i < layerLo[l] || i > layerHi[l])
+        continue;
+      uint32_t q = layerPx[l][i];
+      layerPx[l][i] = 0; // clear as we go - ready for the next frame
+      switch (layerBlend[l])
+      {
+        case BLEND_ADD: p = swarAddSat(p, q); break;
+        case BLEND_MAX: p = swarMax(p, q); break;
+        default: if (q) p = q; break;
+      }
+    }
+    leds[i] = swarUnpack(p);
+  }
+
+  layerUsed = 0;
+  backgroundScale = 255;
+}
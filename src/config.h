@@ -1,30 +1,94 @@
 #ifndef SRC_CONFIG_H
 #define SRC_CONFIG_H
 
+#include <stdint.h>
 
-#define averagingLength 5 // how many samples to average for the player power - keep low (5 or under)
-#define led_brightness 150 //80
-#define audio_volume 20	// 0 to 255
 
+// Defaults for the runtime settings - these can be changed over the serial console
+// and are saved to flash (see settings.h), so no reflash is needed at a venue.
+#define DEFAULT_AVERAGING_LENGTH 5 // how many samples to average for the player power - keep low (5 or under)
+#define MAX_AVERAGING_LENGTH 20    // upper limit for averagingLength (averaging buffers are allocated at this size)
+#define DEFAULT_AUDIO_VOLUME 20	// 0 to 255
+#define DEFAULT_QUALITY_GATE 55 // signal quality at or above this means no one is wearing the headset
+#define DEFAULT_PREDICT 1       // 1 = players driven by the input predictor (see predictor.h), 0 = getAverage()
 
-#define SCREENSAVER_STARTS_TIMEOUT 5000 // time until screen saver in milliseconds
-#define CALIBRATE_TIMEOUT 2000 //3000 //calibrate for 3 or 5 seconds - set to 1000 for Quick calibration
+
+#define DEFAULT_SCREENSAVER_TIMEOUT 5000 // time until screen saver in milliseconds
+#define DEFAULT_CALIBRATE_TIMEOUT 2000 //3000 //calibrate for 3 or 5 seconds - set to 1000 for Quick calibration
 
 
 #define VERSION "2025-08-17"
 
-#define FASTLED_DATA_PIN        19			//for fastled library
+// UDP telemetry for spectator dashboards (see telemetry.h) - off until telem_hz is set
+#define DEFAULT_TELEMETRY_HZ 0
+#define TELEMETRY_SSID "tug32"
+#define TELEMETRY_PASSWORD "tugofwar"
+#define TELEMETRY_PORT 4210
+
 #define DAC_AUDIO_PIN 		25     // on ESP - should be 25 or 26 only
 #define led1Pin 13            // GPIO12 -PWM to Display
 #define led2Pin 12            // GPIO13 - PWM to Display
 
 
-#define NUM_LEDS        		144
-#define PLAYERMAX 100 //0..100 from the nerosky
+// Arenas - games on one board (see arena.h). Two strips side by side: build with -DTUG_ARENAS=2 ([env:twin])
+#ifndef TUG_ARENAS
+  #define TUG_ARENAS 1
+#endif
+#define HEADSET_COUNT (2 * TUG_ARENAS)
+#define ARENA2_DATA_PIN 18    // the second arena's strip
+#define HEADSET_C_RX_PIN 32   // the second arena's headsets - software UARTs (serial_ap.h)
+#define HEADSET_D_RX_PIN 33
+
+// Wireless headset A - an HC-05 SPP module on the headset ([env:bt], -DTUG_BLUETOOTH - see transport.h)
+#define BT_HEADSET_NAME "TUG-A"   // the HC-05's Bluetooth name
+#define BT_HEADSET_PIN "1234"
+#define BT_RETRY_MS 10000         // time between connection attempts while it isn't connected
 
+#define PLAYERMAX 100 //0..100 from the nerosky
+#define COUNTDOWN_STEPS 6 // calibrate countdown 3..2..1 - pairs of dots that close in on the middle
+
+
+// ---- Build variants - pick the strip with a build flag (see the envs in platformio.ini) ----
+// Everything about the strip is a compile time constant, so array sizes and bounds checks are fixed
+// at build time. The strip length in use (led_count) can still be set lower at runtime.
+struct GameVariant
+{
+  const char* name;
+  uint16_t numLeds;           // strip length - the most the game will drive
+  uint8_t dataPin;            // for fastled library
+  uint16_t colourOrder;       // FastLED EOrder - RGB 0012, GRB 0102
+  bool rgbw;                  // strip has a white channel
+  uint8_t brightness;         // default brightness
+  uint32_t colourA;           // player colours 0xRRGGBB
+  uint32_t colourB;
+  uint8_t countdownSpacing;   // leds between the countdown dots
+};
+
+#if defined(TUG_VARIANT_TRAVEL60)
+  constexpr GameVariant variant = {"travel60", 60, 19, 0102, false, 180, 0x3F2900, 0x003F00, 4};
+#elif defined(TUG_VARIANT_ARENA300)
+  constexpr GameVariant variant = {"arena300", 300, 19, 0102, false, 100, 0x3F2900, 0x003F00, 12};
+#else
+  // 144 leds in about 1 meter - wrgb
+  constexpr GameVariant variant = {"rgbw144", 144, 19, 0102, true, 150, 0x3F2900, 0x003F00, 6}; // ORANGE, GREEN
+#endif
 
-#define PLAYER_COLOUR_A CRGB(255/4, 165/4, 0) // ORANGE
-#define PLAYER_COLOUR_B CRGB(0, 255/4, 0)   //GREEN
+#define NUM_LEDS variant.numLeds
+#define FASTLED_DATA_PIN variant.dataPin
+#define DEFAULT_LED_BRIGHTNESS variant.brightness
+#define PLAYER_COLOUR_A CRGB(variant.colourA)
+#define PLAYER_COLOUR_B CRGB(variant.colourB)
+#define COUNTDOWN_SPACING variant.countdownSpacing
+#define LED_GAMMA 1.0f  // gamma of the pixel pipeline (pixels.h) - 1.0 is linear, the colours FastLED always sent
+// shortest strip the countdown fits on - the "leds" setting can't go below this
+#define MIN_LEDS (2 * (COUNTDOWN_STEPS * COUNTDOWN_SPACING + 2))
+
+// The countdown in tickCalibrate lights led_count/2 +/- (COUNTDOWN_STEPS * COUNTDOWN_SPACING) and one either side
+static_assert(MIN_LEDS / 2 + COUNTDOWN_STEPS * COUNTDOWN_SPACING < MIN_LEDS, "countdown dots run off the end of the strip");
+static_assert(MIN_LEDS / 2 >= COUNTDOWN_STEPS * COUNTDOWN_SPACING + 1, "countdown dots run off the start of the strip");
+static_assert(MIN_LEDS <= NUM_LEDS, "strip too short for the countdown - lower countdownSpacing");
+static_assert(NUM_LEDS > 12, "strip too short - the exit zones are 5 leds at each end");
+static_assert(NUM_LEDS <= 1000, "strip too long for the particle positions (0..1000)");
 
 //CRGB(0, 35, 00); // faint green toward Player A
 //CRGB(0, 0, 35); // faint blue toward Player B
@@ -36,11 +100,30 @@
 #define GAMEOVER_SPREAD_DURATION 1000
 
 //NEOPIXEL details
-#define MIN_REDRAW_INTERVAL 	1000.0 / 60.0    // divide by frames per second..if you tweak adjust player speed
-#define led_count NUM_LEDS
+#define FRAME_RATE 60     // frames per second..if you tweak adjust player speed
+#define FRAME_INTERVAL_US (1000000 / FRAME_RATE)
+#define IDLE_FRAME_RATE 20  // screensaver / nobody at the headsets (see power.h)
+#define IDLE_CPU_MHZ 80     // lowest CPU clock while idle
+
+// Headset presence (see presence.h)
+#define PRESENCE_SILENT_MS 60       // no good packets for this long = unplugged (headsets streaming raw samples)
+#define PRESENCE_MISSED_PACKETS 2   // ... or for this many packet intervals (headsets sending 1 Hz packets only)
+#define PRESENCE_RAW_RAIL 2000      // |raw sample| this big = the sensor is off the skin (the input saturates)
 
 
 #include <arduino.h>
+
+// Runtime settings (defaults above) - defined and persisted in settings.h
+extern uint8_t averagingLength;
+extern uint8_t led_brightness;
+extern uint8_t audio_volume;
+extern uint8_t qualityGate;
+extern uint16_t screensaverTimeout;
+extern uint16_t calibrateTimeout;
+extern uint16_t led_count;
+extern uint8_t telemetryHz;
+extern uint8_t predictInput;
+
 void logln(char* s);
 void logln(const char* s);
 void logln(int s);
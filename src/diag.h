@@ -0,0 +1,151 @@
+/*
+  Task diagnostics - CPU use and stack head room of every FreeRTOS task.
+
+  Once a second a low priority task reads the FreeRTOS task list and keeps, for each task:
+    - CPU % over the last second (needs FreeRTOS run time stats - shows "-" without them)
+    - the least free stack it has ever had (uxTaskGetStackHighWaterMark)
+  plus the load of each core (100% minus the time its idle task ran).
+
+  A warning is logged the first time a task gets within DIAG_STACK_WARN bytes of the end of
+  its stack - use "tasks" on the serial console to see the table and right-size the stacks
+  in tasks.h.
+*/
+#pragma once
+
+#include <Arduino.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include "config.h"
+#include "tasks.h"
+#include "settings.h"
+
+#define DIAG_MAX_TASKS 24
+#define DIAG_PERIOD_MS 1000
+#define DIAG_STACK_WARN 512   // bytes free
+
+struct DiagTask
+{
+  TaskHandle_t handle;
+  char name[configMAX_TASK_NAME_LEN];
+  int8_t core;                // -1 = not pinned
+  uint32_t lastRunTime;
+  uint8_t cpuPercent;
+  uint32_t minFreeStack;      // bytes
+  bool warned;
+};
+
+static TaskStatus_t diagStatus[DIAG_MAX_TASKS];
+static DiagTask diagTasks[DIAG_MAX_TASKS];
+static uint8_t diagTaskCount = 0;
+static uint32_t diagLastTotal = 0;
+static uint8_t diagCoreLoad[2] = {0, 0};
+static TaskHandle_t diagTaskHandle = NULL;
+static SemaphoreHandle_t diagLock = NULL;
+
+DiagTask* diagFind(TaskHandle_t h, const char* name)
+{
+  for (int i = 0; i < diagTaskCount; i++)
+  {
+    if (diagTasks[i].handle == h)
+      return &diagTasks[i];
+  }
+  if (diagTaskCount >= DIAG_MAX_TASKS)
+    return NULL;
+  DiagTask* t = &diagTasks[diagTaskCount++];
+  memset(t, 0, sizeof(*t));
+  t->handle = h;
+  strlcpy(t->name, name, sizeof(t->name));
+  t->minFreeStack = UINT32_MAX;
+  return t;
+}
+
+void diagSample()
+{
+  uint32_t total = 0;
+  UBaseType_t n = uxTaskGetSystemState(diagStatus, DIAG_MAX_TASKS, &total);
+  uint32_t elapsed = total - diagLastTotal; // run time counter ticks of wall clock time - so a task's % is of one core
+  diagLastTotal = total;
+  (void)elapsed;
+
+  xSemaphoreTake(diagLock, portMAX_DELAY);
+  for (UBaseType_t i = 0; i < n; i++)
+  {
+    TaskStatus_t& s = diagStatus[i];
+    DiagTask* t = diagFind(s.xHandle, s.pcTaskName);
+    if (t == NULL)
+      continue;
+
+    #if configGENERATE_RUN_TIME_STATS
+      uint32_t ran = s.ulRunTimeCounter - t->lastRunTime;
+      t->lastRunTime = s.ulRunTimeCounter;
+      t->cpuPercent = elapsed ? (uint8_t)min(100ULL, (uint64_t)ran * 100 / elapsed) : 0;
+    #endif
+    #if configTASKLIST_INCLUDE_COREID
+      t->core = s.xCoreID < 2 ? s.xCoreID : -1;
+    #else
+      t->core = -1;
+    #endif
+
+    uint32_t freeStack = s.usStackHighWaterMark; // bytes on ESP-IDF
+    if (freeStack < t->minFreeStack)
+      t->minFreeStack = freeStack;
+    if (!t->warned && t->minFreeStack < DIAG_STACK_WARN)
+    {
+      t->warned = true;
+      Serial.printf("WARNING: task %s has only %u bytes of stack left\n", t->name, t->minFreeStack);
+    }
+  }
+
+  #if configGENERATE_RUN_TIME_STATS
+    // the total is wall clock time (IDF's real_time_stats divides it by the core count for a
+    // share of the whole chip), so an idle task's % is already of its own core
+    for (int core = 0; core < 2; core++)
+    {
+      DiagTask* idle = diagFind(xTaskGetIdleTaskHandleForCPU(core), "IDLE");
+      if (idle != NULL)
+        diagCoreLoad[core] = 100 - min(100, (int)idle->cpuPercent);
+    }
+  #endif
+  xSemaphoreGive(diagLock);
+}
+
+void diagTask(void *pvParameters)
+{
+  TickType_t wake = xTaskGetTickCount();
+  for (;;)
+  {
+    vTaskDelayUntil(&wake, pdMS_TO_TICKS(DIAG_PERIOD_MS));
+    diagSample();
+  }
+}
+
+void diagCommand(char* arg1, char* arg2)
+{
+  xSemaphoreTake(diagLock, portMAX_DELAY);
+  Serial.println("task              core  cpu%  min free stack");
+  for (int i = 0; i < diagTaskCount; i++)
+  {
+    DiagTask& t = diagTasks[i];
+    char core[4] = "-";
+    if (t.core >= 0)
+      core[0] = '0' + t.core;
+    #if configGENERATE_RUN_TIME_STATS
+      Serial.printf("%-16s  %4s  %4u  %6u\n", t.name, core, t.cpuPercent, t.minFreeStack);
+    #else
+      Serial.printf("%-16s  %4s     -  %6u\n", t.name, core, t.minFreeStack);
+    #endif
+  }
+  #if configGENERATE_RUN_TIME_STATS
+    Serial.printf("core load: 0: %u%%  1: %u%%\n", diagCoreLoad[0], diagCoreLoad[1]);
+  #else
+    Serial.println("(no CPU figures - FreeRTOS run time stats are off in this build)");
+  #endif
+  xSemaphoreGive(diagLock);
+}
+
+void diag_setup()
+{
+  diagLock = xSemaphoreCreateMutex();
+  task_create(diagTask, "Diag", TASK_DIAG, &diagTaskHandle);
+  console_add("tasks", diagCommand);
+}
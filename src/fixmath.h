@@ -0,0 +1,100 @@
+/*
+  Fixed point maths for the sounds and animations - no float, no divide per call.
+
+  Angles are phases: a uint16_t where 65536 is one full turn (so they wrap for free).
+  Waveforms are Q15: -32767..32767 stands for -1.0..1.0.
+
+    sin15(phase)           sine, from a quarter wave table with linear interpolation
+    tri15(phase)           triangle, in phase with the sine
+    phaseAt(ms, step)      the phase of a wave at a time - step from PHASE_STEP_MS / PHASE_STEP_RAD
+    unit8(q15)             a Q15 wave as 0..255 (for PWM and brightness)
+    FixMap                 map() for a range that never changes - a multiply and a shift
+    fixLerp(a, b, t16)     a..b by t16 (0..65536), t16 saturated to that range
+
+  The float versions these replace are checked for accuracy and timed in tools/fixbench.
+*/
+#pragma once
+
+#include <stdint.h>
+
+// sin of 0..90 degrees in 64 steps, Q15
+static const int16_t sinQuarter[65] = {
+      0,   804,  1608,  2410,  3212,  4011,  4808,  5602,  6393,
+   7179,  7962,  8739,  9512, 10278, 11039, 11793, 12539, 13279,
+  14010, 14732, 15446, 16151, 16846, 17530, 18204, 18868, 19519,
+  20159, 20787, 21403, 22005, 22594, 23170, 23731, 24279, 24811,
+  25329, 25832, 26319, 26790, 27245, 27683, 28105, 28510, 28898,
+  29268, 29621, 29956, 30273, 30571, 30852, 31113, 31356, 31580,
+  31785, 31971, 32137, 32285, 32412, 32521, 32609, 32678, 32728,
+  32757, 32767,
+};
+
+inline int16_t sin15(uint16_t phase)
+{
+  uint16_t x = phase & 0x3FFF;       // position inside the quarter
+  if (phase & 0x4000)
+    x = 0x4000 - x;                  // 2nd and 4th quarters run backwards
+  uint16_t i = x >> 8;
+  uint16_t frac = x & 0xFF;
+  int16_t v = sinQuarter[i];
+  if (frac)
+    v += ((sinQuarter[i + 1] - v) * frac) >> 8;
+  return (phase & 0x8000) ? -v : v;  // 2nd half is negative
+}
+
+inline int16_t tri15(uint16_t phase)
+{
+  int32_t v;
+  if (phase < 0x4000)
+    v = phase * 2;
+  else if (phase < 0xC000)
+    v = (0x8000 - (int32_t)phase) * 2;
+  else
+    v = ((int32_t)phase - 0x10000) * 2;
+  if (v > 32767) v = 32767;
+  if (v < -32767) v = -32767;
+  return v;
+}
+
+// phase step per millisecond for a wave that repeats every periodMs
+#define PHASE_STEP_MS(periodMs) ((uint32_t)(4294967296.0 / (periodMs)))
+// phase step per millisecond for sin(ms / divisor) - the "sin(millis() / 20.0)" style
+#define PHASE_STEP_RAD(divisor) ((uint32_t)(4294967296.0 / (6.283185307179586 * (divisor))))
+
+// phase at a time - the step is phase << 16 per ms, so the multiply wraps with the turns
+inline uint16_t phaseAt(uint32_t ms, uint32_t step)
+{
+  return (ms * step) >> 16;
+}
+
+// -32767..32767 -> 0..255
+inline uint8_t unit8(int16_t q15)
+{
+  return ((int32_t)q15 + 32768) >> 8;
+}
+
+// map() for a fixed range: the divide is done once, when the FixMap is made (make them constexpr)
+struct FixMap
+{
+  int32_t inMin;
+  int32_t outMin;
+  int32_t mul;    // (outMax - outMin) / (inMax - inMin), Q16, rounded up so the ends land exactly
+
+  constexpr FixMap(int32_t inMin, int32_t inMax, int32_t outMin, int32_t outMax)
+    : inMin(inMin), outMin(outMin),
+      mul((int32_t)(((int64_t)(outMax - outMin) * 65536 + (inMax - inMin) - 1) / (inMax - inMin))) {}
+
+  // keep (x - inMin) * mul inside 32 bits: |x - inMin| * |outMax - outMin| < 32768 * (inMax - inMin)
+  inline int32_t operator()(int32_t x) const
+  {
+    return outMin + (((x - inMin) * mul) >> 16);
+  }
+};
+
+// a + (b - a) * t16 / 65536, t16 saturated to 0..65536 - |b - a| under 32768
+inline int32_t fixLerp(int32_t a, int32_t b, int32_t t16)
+{
+  if (t16 <= 0) return a;
+  if (t16 >= 65536) return b;
+  return a + (((b - a) * t16) >> 16);
+}
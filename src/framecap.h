@@ -0,0 +1,201 @@
+/*
+  Frame capture - a virtual copy of the strip for checking rendering without looking at it.
+
+  Every frame the finished leds[] is copied into a small ring buffer just before it is sent
+  to the strip, along with a checksum of the frame and how long the frame took to render.
+
+  Serial console:
+    frames             - checksum and render time of the captured frames, plus render time stats
+    frames show        - the captured frames as lines of ANSI colour blocks (use a colour terminal)
+    frames ppm         - the captured frames as a plain PPM image (one row per frame)
+    frames test        - render the fixed test scenes and compare them against the saved golden checksums
+    frames golden      - render the test scenes and save their checksums as the new goldens
+
+  The test scenes (renderTestScene() in ESP32TUG.ino) drive the stage code - startup, play,
+  explosion, calibrate - and the screensavers with fixed times, fixed player values and fixed
+  random seeds, so a scene always gives the same frame.
+  Record the goldens on a build you know looks right; after a change, "frames test" tells
+  you which stages render differently. Goldens are per strip length. The scenes draw into the
+  selected arena, which is saved and put back around them, so a test can run mid game.
+*/
+#pragma once
+
+#include <Arduino.h>
+#include <FastLED.h>
+#include <LittleFS.h>
+#include "config.h"
+#include "settings.h"
+#include "compositor.h"
+
+#define FRAMECAP_FRAMES 8     // frames kept in the ring
+#define FRAMECAP_SCENES 16    // most test scenes
+#define FRAMECAP_GOLDEN "/golden"
+
+extern CRGB* leds;   // the strip being drawn (arena.h)
+bool renderTestScene(int scene); // in ESP32TUG.ino - false when there are no more scenes
+
+static CRGB frameRing[FRAMECAP_FRAMES][NUM_LEDS];
+static uint32_t frameSum[FRAMECAP_FRAMES];
+static uint32_t frameRenderUs[FRAMECAP_FRAMES];
+static uint8_t frameHead = 0;          // next slot to write
+static uint32_t frameCount = 0;
+static uint32_t frameStartUs = 0;
+static uint32_t frameUsMax = 0;
+static uint64_t frameUsTotal = 0;
+
+// FNV-1a over the used part of the strip
+uint32_t frameChecksum(const CRGB* px, int count)
+{
+  const uint8_t* p = (const uint8_t*)px;
+  uint32_t h = 2166136261u;
+  for (int i = 0; i < count * 3; i++)
+  {
+    h ^= p[i];
+    h *= 16777619u;
+  }
+  return h;
+}
+
+/** framecap_begin()
+ *  Call at the start of the frame, before anything is drawn.
+ */
+void framecap_begin()
+{
+  frameStartUs = micros();
+}
+
+/** framecap_end()
+ *  Call when the frame is drawn - just before it is shown.
+ */
+void framecap_end()
+{
+  uint32_t us = micros() - frameStartUs;
+  memcpy(frameRing[frameHead], leds, led_count * sizeof(CRGB));
+  frameSum[frameHead] = frameChecksum(leds, led_count);
+  frameRenderUs[frameHead] = us;
+  frameHead = (frameHead + 1) % FRAMECAP_FRAMES;
+
+  frameCount++;
+  frameUsTotal += us;
+  if (us > frameUsMax)
+    frameUsMax = us;
+}
+
+// oldest captured frame first
+int frameSlot(int i)
+{
+  return (frameHead + i) % FRAMECAP_FRAMES;
+}
+
+void framecapShowAnsi()
+{
+  for (int f = 0; f < FRAMECAP_FRAMES; f++)
+  {
+    const CRGB* px = frameRing[frameSlot(f)];
+    for (int i = 0; i < led_count; i++)
+      Serial.printf("\x1b[48;2;%u;%u;%um ", px[i].r, px[i].g, px[i].b);
+    Serial.println("\x1b[0m");
+  }
+}
+
+void framecapShowPpm()
+{
+  Serial.printf("P3\n%u %u\n255\n", led_count, FRAMECAP_FRAMES);
+  for (int f = 0; f < FRAMECAP_FRAMES; f++)
+  {
+    const CRGB* px = frameRing[frameSlot(f)];
+    for (int i = 0; i < led_count; i++)
+      Serial.printf("%u %u %u ", px[i].r, px[i].g, px[i].b);
+    Serial.println();
+  }
+}
+
+// render every test scene - fills sums[] and returns how many scenes there are
+int framecapRunScenes(uint32_t* sums)
+{
+  int n = 0;
+  while (n < FRAMECAP_SCENES)
+  {
+    if (!renderTestScene(n))
+      break;
+    compositor_flatten();
+    sums[n++] = frameChecksum(leds, led_count);
+  }
+  return n; // renderTestScene() has put the arena and its strip back
+}
+
+void framecapTest(bool saveGolden)
+{
+  uint32_t sums[FRAMECAP_SCENES];
+  int n = framecapRunScenes(sums);
+
+  if (saveGolden)
+  {
+    File f = LittleFS.open(FRAMECAP_GOLDEN, "w");
+    if (!f)
+    {
+      logln("ERROR: can't write goldens");
+      return;
+    }
+    f.write((uint8_t*)&led_count, sizeof(led_count));
+    f.write((uint8_t*)sums, n * sizeof(uint32_t));
+    f.close();
+    Serial.printf("saved %d golden frames for %u leds\n", n, led_count);
+    return;
+  }
+
+  uint16_t goldenLeds = 0;
+  uint32_t golden[FRAMECAP_SCENES];
+  int goldenCount = 0;
+  File f = LittleFS.open(FRAMECAP_GOLDEN, "r");
+  if (f)
+  {
+    f.read((uint8_t*)&goldenLeds, sizeof(goldenLeds));
+    goldenCount = f.read((uint8_t*)golden, sizeof(golden)) / sizeof(uint32_t);
+    f.close();
+  }
+  if (goldenCount == 0 || goldenLeds != led_count)
+  {
+    Serial.printf("no goldens for %u leds - run \"frames golden\" on a good build first\n", led_count);
+    goldenCount = 0;
+  }
+
+  int failed = 0;
+  for (int i = 0; i < n; i++)
+  {
+    bool ok = i < goldenCount && golden[i] == sums[i];
+    failed += !ok;
+    Serial.printf("scene %d: %08x %s\n", i, sums[i], i >= goldenCount ? "(no golden)" : ok ? "OK" : "DIFFERENT");
+  }
+  Serial.printf("%d of %d scenes match\n", n - failed, n);
+}
+
+void framecapCommand(char* arg1, char* arg2)
+{
+  if (arg1 == NULL)
+  {
+    for (int f = 0; f < FRAMECAP_FRAMES; f++)
+    {
+      int s = frameSlot(f);
+      Serial.printf("%08x %5u us\n", frameSum[s], frameRenderUs[s]);
+    }
+    Serial.printf("render: %u frames, mean %u us, max %u us\n", frameCount,
+                  frameCount ? (uint32_t)(frameUsTotal / frameCount) : 0, frameUsMax);
+    frameUsMax = 0; // max since the last look
+  }
+  else if (strcmp(arg1, "show") == 0)
+    framecapShowAnsi();
+  else if (strcmp(arg1, "ppm") == 0)
+    framecapShowPpm();
+  else if (strcmp(arg1, "test") == 0)
+    framecapTest(false);
+  else if (strcmp(arg1, "golden") == 0)
+    framecapTest(true);
+  else
+    logln("frames [show|ppm|test|golden]");
+}
+
+void framecap_setup()
+{
+  console_add("frames", framecapCommand);
+}
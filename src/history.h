@@ -0,0 +1,424 @@
+/*
+  Band power history - the last several minutes of every headset packet, per player, in RAM.
+
+  One record per packet with band powers (about once a second): the eight band powers, the
+  attention the game used and the headset's own signal quality. Everything is preallocated -
+  no heap, no flash writes - and a full store drops its oldest data.
+
+  Two parts:
+    - the log, for replays: records packed into HISTORY_BLOCKS blocks of HISTORY_BLOCK_BYTES.
+      Each block starts with a keyframe (absolute values as varints); the records after it are
+      zigzag varint deltas from the record before. A full log drops its oldest block.
+      historyNext() walks it oldest first.
+    - the tiers, for trends: min / sum / max of every field per bucket of HISTORY_FANOUT^(t+1)
+      records (4, 16, 64), HISTORY_TIER_BUCKETS buckets a tier, plus the newest HISTORY_RECENT
+      records unpacked.
+
+  historyWindow() - min / mean / max of a field over the last n records - steps back from the
+  newest record: single records up to a 4 record boundary, then at most HISTORY_FANOUT - 1
+  buckets of each tier up to the next tier's boundary, then top tier buckets. A constant
+  number of steps per tier, whatever the window. The far end of the window is rounded down
+  to the bucket size of the tier it reaches into - count says how many records were used.
+
+  Checked against a brute force reference, and the bytes per record measured, in tools/histcheck.
+
+  Serial console:  history       - packets logged and the attention / quality trends
+                   history dump  - every logged packet's attention and quality as CSV
+                                   (a recorded trace for tools/predictcheck)
+*/
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+#define HISTORY_BANDS 8
+#define HISTORY_FIELDS (HISTORY_BANDS + 2)
+#define HISTORY_BLOCK_BYTES 256
+#define HISTORY_BLOCKS 28            // 7 KB of log a player - about 5 minutes of packets
+#define HISTORY_RECENT 16            // newest records kept unpacked (at least HISTORY_FANOUT - 1)
+#define HISTORY_TIERS 3
+#define HISTORY_FANOUT 4
+#define HISTORY_TIER_BUCKETS 8       // the tiers reach back 32, 128 and 512 records
+#define HISTORY_MAX_RECORD 64        // bytes - a keyframe or delta record packs smaller than this
+
+enum HistoryField
+{
+  HIST_DELTA, HIST_THETA, HIST_LOW_ALPHA, HIST_HIGH_ALPHA,
+  HIST_LOW_BETA, HIST_HIGH_BETA, HIST_LOW_GAMMA, HIST_MID_GAMMA,
+  HIST_ATTENTION,
+  HIST_QUALITY
+};
+
+struct HistoryRecord
+{
+  uint32_t ms;                       // millis() when the packet was parsed
+  uint32_t value[HISTORY_FIELDS];    // the bands (24 bit), attention, quality - HistoryField order
+};
+
+struct HistoryBucket
+{
+  uint32_t min[HISTORY_FIELDS];
+  uint32_t max[HISTORY_FIELDS];
+  uint32_t sum[HISTORY_FIELDS];      // 64 records of 24 bit values fit
+};
+
+struct HistoryStats
+{
+  uint32_t min;
+  uint32_t max;
+  uint32_t mean;
+  uint32_t count;                    // records in the window (0 = none)
+};
+
+struct History
+{
+  uint32_t records;                  // added since the start
+  // log
+  uint8_t log[HISTORY_BLOCKS][HISTORY_BLOCK_BYTES];
+  uint16_t blockBytes[HISTORY_BLOCKS];
+  uint16_t blockRecords[HISTORY_BLOCKS];
+  uint32_t firstBlock;               // block number of the oldest block (block n is log[n % HISTORY_BLOCKS])
+  uint8_t blocks;                    // blocks in use
+  HistoryRecord last;                // the record the next delta is from
+  // tiers
+  HistoryRecord recent[HISTORY_RECENT];
+  HistoryBucket open[HISTORY_TIERS];                       // buckets being filled
+  HistoryBucket tier[HISTORY_TIERS][HISTORY_TIER_BUCKETS];
+};
+
+// where historyNext() is in the log
+struct HistoryCursor
+{
+  uint32_t block;                    // block number
+  uint16_t offset;                   // byte in the block
+  uint16_t record;                   // record in the block
+  HistoryRecord last;
+};
+
+// records per bucket of tier t
+inline uint32_t historyBucketSize(int t)
+{
+  uint32_t size = HISTORY_FANOUT;
+  while (t-- > 0)
+    size *= HISTORY_FANOUT;
+  return size;
+}
+
+// ---- packing ----
+inline uint8_t* historyPutVarint(uint8_t* p, uint32_t v)
+{
+  while (v >= 0x80)
+  {
+    *p++ = (uint8_t)v | 0x80;
+    v >>= 7;
+  }
+  *p++ = (uint8_t)v;
+  return p;
+}
+
+inline const uint8_t* historyGetVarint(const uint8_t* p, uint32_t& v)
+{
+  v = 0;
+  for (int shift = 0; shift < 35; shift += 7)
+  {
+    uint8_t b = *p++;
+    v |= (uint32_t)(b & 0x7F) << shift;
+    if (!(b & 0x80))
+      break;
+  }
+  return p;
+}
+
+// small signed differences -> small unsigned numbers: 0, -1, 1, -2 ... -> 0, 1, 2, 3 ...
+inline uint32_t historyZigzag(int32_t v) { return ((uint32_t)v << 1) ^ (uint32_t)(v >> 31); }
+inline int32_t historyUnzigzag(uint32_t v) { return (int32_t)(v >> 1) ^ -(int32_t)(v & 1); }
+
+// pack r into out - a keyframe when prev is NULL. Returns the bytes used.
+inline size_t historyPack(uint8_t* out, const HistoryRecord& r, const HistoryRecord* prev)
+{
+  uint8_t* p = out;
+  p = historyPutVarint(p, prev ? r.ms - prev->ms : r.ms);
+  for (int f = 0; f < HISTORY_FIELDS; f++)
+    p = historyPutVarint(p, prev ? historyZigzag((int32_t)(r.value[f] - prev->value[f])) : r.value[f]);
+  return p - out;
+}
+
+inline const uint8_t* historyUnpack(const uint8_t* p, HistoryRecord& r, const HistoryRecord* prev)
+{
+  uint32_t v;
+  p = historyGetVarint(p, v);
+  r.ms = prev ? prev->ms + v : v;
+  for (int f = 0; f < HISTORY_FIELDS; f++)
+  {
+    p = historyGetVarint(p, v);
+    r.value[f] = prev ? prev->value[f] + (uint32_t)historyUnzigzag(v) : v;
+  }
+  return p;
+}
+
+// ---- adding ----
+inline void historyBucketStart(HistoryBucket& b, const HistoryRecord& r)
+{
+  for (int f = 0; f < HISTORY_FIELDS; f++)
+    b.min[f] = b.max[f] = b.sum[f] = r.value[f];
+}
+
+inline void historyBucketAdd(HistoryBucket& b, const HistoryRecord& r)
+{
+  for (int f = 0; f < HISTORY_FIELDS; f++)
+  {
+    uint32_t v = r.value[f];
+    if (v < b.min[f]) b.min[f] = v;
+    if (v > b.max[f]) b.max[f] = v;
+    b.sum[f] += v;
+  }
+}
+
+void historyClear(History& h)
+{
+  memset(&h, 0, sizeof(h));
+}
+
+void historyAdd(History& h, const HistoryRecord& r)
+{
+  // log - a delta into the newest block, or a keyframe starting the next one
+  uint8_t packed[HISTORY_MAX_RECORD];
+  uint8_t newest = (h.firstBlock + h.blocks - 1) % HISTORY_BLOCKS;
+  size_t len = h.blocks ? historyPack(packed, r, &h.last) : 0;
+  if (h.blocks == 0 || h.blockBytes[newest] + len > HISTORY_BLOCK_BYTES)
+  {
+    if (h.blocks == HISTORY_BLOCKS)
+    {// full - drop the oldest block
+      h.firstBlock++;
+      h.blocks--;
+    }
+    newest = (h.firstBlock + h.blocks) % HISTORY_BLOCKS;
+    h.blocks++;
+    h.blockBytes[newest] = 0;
+    h.blockRecords[newest] = 0;
+    len = historyPack(packed, r, NULL);
+  }
+  memcpy(h.log[newest] + h.blockBytes[newest], packed, len);
+  h.blockBytes[newest] += len;
+  h.blockRecords[newest]++;
+  h.last = r;
+
+  // tiers
+  h.recent[h.records % HISTORY_RECENT] = r;
+  for (int t = 0; t < HISTORY_TIERS; t++)
+  {
+    uint32_t size = historyBucketSize(t);
+    if (h.records % size == 0)
+      historyBucketStart(h.open[t], r);
+    else
+      historyBucketAdd(h.open[t], r);
+    if ((h.records + 1) % size == 0)
+      h.tier[t][(h.records / size) % HISTORY_TIER_BUCKETS] = h.open[t];
+  }
+  h.records++;
+}
+
+// ---- reading ----
+/** historyWindow()
+ *  min / mean / max of field over the last n records.
+ */
+HistoryStats historyWindow(const History& h, HistoryField field, uint32_t n)
+{
+  HistoryStats s = {UINT32_MAX, 0, 0, 0};
+  uint64_t sum = 0;
+  if (n > h.records)
+    n = h.records;
+  uint32_t end = h.records;   // the window is records [end - taken, h.records)
+
+  // single records back to a bucket boundary
+  while (s.count < n && end % HISTORY_FANOUT != 0)
+  {
+    uint32_t v = h.recent[(end - 1) % HISTORY_RECENT].value[field];
+    if (v < s.min) s.min = v;
+    if (v > s.max) s.max = v;
+    sum += v;
+    end--;
+    s.count++;
+  }
+
+  // then whole buckets, coarser as the boundaries line up
+  for (int t = 0; t < HISTORY_TIERS; t++)
+  {
+    uint32_t size = historyBucketSize(t);
+    uint32_t closed = h.records / size;
+    bool top = t == HISTORY_TIERS - 1;
+    while (n - s.count >= size && (top || end % (size * HISTORY_FANOUT) != 0))
+    {
+      uint32_t bucket = end / size - 1;
+      if (bucket + HISTORY_TIER_BUCKETS < closed)
+      {
+        n = s.count; // older than the tiers keep - the window stops here
+        break;
+      }
+      const HistoryBucket& b = h.tier[t][bucket % HISTORY_TIER_BUCKETS];
+      if (b.min[field] < s.min) s.min = b.min[field];
+      if (b.max[field] > s.max) s.max = b.max[field];
+      sum += b.sum[field];
+      end -= size;
+      s.count += size;
+    }
+    if (n - s.count < size)
+      break; // the far end falls inside a bucket of this tier - rounded down
+  }
+
+  if (s.count == 0)
+    s.min = 0;
+  else
+    s.mean = (uint32_t)(sum / s.count);
+  return s;
+}
+
+// records in the log
+uint32_t historyLogged(const History& h)
+{
+  uint32_t n = 0;
+  for (int i = 0; i < h.blocks; i++)
+    n += h.blockRecords[(h.firstBlock + i) % HISTORY_BLOCKS];
+  return n;
+}
+
+uint32_t historyLogBytes(const History& h)
+{
+  uint32_t n = 0;
+  for (int i = 0; i < h.blocks; i++)
+    n += h.blockBytes[(h.firstBlock + i) % HISTORY_BLOCKS];
+  return n;
+}
+
+// start a walk through the log at its oldest record
+inline void historyCursorStart(const History& h, HistoryCursor& c)
+{
+  memset(&c, 0, sizeof(c));
+  c.block = h.firstBlock;
+}
+
+/** historyNext()
+ *  The next record of the log, oldest first - false at the newest. If the walk fell behind
+ *  and its block was dropped it carries on from the oldest block still there.
+ */
+bool historyNext(const History& h, HistoryCursor& c, HistoryRecord& r)
+{
+  if (c.block < h.firstBlock)
+  {
+    c.block = h.firstBlock;
+    c.offset = c.record = 0;
+  }
+  while (c.block < h.firstBlock + h.blocks)
+  {
+    uint8_t i = c.block % HISTORY_BLOCKS;
+    if (c.record < h.blockRecords[i])
+    {
+      const uint8_t* p = h.log[i] + c.offset;
+      c.offset = historyUnpack(p, r, c.record ? &c.last : NULL) - h.log[i];
+      c.record++;
+      c.last = r;
+      return true;
+    }
+    c.block++;
+    c.offset = c.record = 0;
+  }
+  return false;
+}
+
+#ifdef ARDUINO
+#include <Arduino.h>
+#include "config.h"
+#include "Brain.h"
+#include "settings.h"
+
+// written as packets are dispatched, read by loop() and the console - short critical sections either side
+static History history[HEADSET_COUNT];
+static portMUX_TYPE historyLock = portMUX_INITIALIZER_UNLOCKED;
+static uint16_t historyPowerSeq[HEADSET_COUNT];
+
+/** history_packet()
+ *  loop(), as packets are dispatched (bt_dispatch() - serial_ap.h) - records the brain's
+ *  latest packet with band powers.
+ *  player - the headset (0..HEADSET_COUNT-1 - A, B, then the second arena's C, D).
+ */
+void history_packet(int player, const Brain& brain)
+{
+  if (brain.powerSeq == historyPowerSeq[player])
+    return;
+  historyPowerSeq[player] = brain.powerSeq;
+  HistoryRecord r;
+  r.ms = millis();
+  for (int f = 0; f < HISTORY_BANDS; f++)
+    r.value[f] = brain.powerBands[f];
+  r.value[HIST_ATTENTION] = brain.powerAttention;
+  r.value[HIST_QUALITY] = brain.powerQuality;
+  portENTER_CRITICAL(&historyLock);
+  historyAdd(history[player], r);
+  portEXIT_CRITICAL(&historyLock);
+}
+
+// loop() - a field's trend over the last n packets
+HistoryStats history_window(int player, HistoryField field, uint32_t n)
+{
+  portENTER_CRITICAL(&historyLock);
+  HistoryStats s = historyWindow(history[player], field, n);
+  portEXIT_CRITICAL(&historyLock);
+  return s;
+}
+
+// loop() - one record at a time, for a replay
+bool history_next(int player, HistoryCursor& c, HistoryRecord& r)
+{
+  portENTER_CRITICAL(&historyLock);
+  bool ok = historyNext(history[player], c, r);
+  portEXIT_CRITICAL(&historyLock);
+  return ok;
+}
+
+void historyCommand(char* arg1, char* arg2)
+{
+  if (arg1 != NULL && strcmp(arg1, "dump") == 0)
+  {// every logged packet as CSV - tools/predictcheck replays these
+    Serial.println("HISTORY_BEGIN");
+    Serial.println("player,ms,attention,quality");
+    for (int p = 0; p < HEADSET_COUNT; p++)
+    {
+      HistoryCursor c;
+      HistoryRecord r;
+      portENTER_CRITICAL(&historyLock);
+      historyCursorStart(history[p], c);
+      portEXIT_CRITICAL(&historyLock);
+      while (history_next(p, c, r))
+        Serial.printf("%c,%u,%u,%u\n", 'A' + p, r.ms, r.value[HIST_ATTENTION], r.value[HIST_QUALITY]);
+    }
+    Serial.println("HISTORY_END");
+    return;
+  }
+  for (int p = 0; p < HEADSET_COUNT; p++)
+  {
+    portENTER_CRITICAL(&historyLock);
+    uint32_t logged = historyLogged(history[p]);
+    uint32_t bytes = historyLogBytes(history[p]);
+    uint32_t records = history[p].records;
+    portEXIT_CRITICAL(&historyLock);
+    Serial.printf("%c: %u packets, %u in the log (%u bytes, %u.%u bytes a packet)\n", 'A' + p, records, logged,
+                  bytes, logged ? bytes / logged : 0, logged ? bytes * 10 / logged % 10 : 0);
+    const uint32_t windows[] = {60, 300};
+    for (uint32_t n : windows)
+    {
+      HistoryStats a = history_window(p, HIST_ATTENTION, n);
+      HistoryStats q = history_window(p, HIST_QUALITY, n);
+      Serial.printf("   last %u: attention %u/%u/%u, quality %u/%u/%u (min/mean/max of %u)\n", n,
+                    a.min, a.mean, a.max, q.min, q.mean, q.max, a.count);
+    }
+  }
+}
+
+void history_setup()
+{
+  for (int p = 0; p < HEADSET_COUNT; p++)
+    historyClear(history[p]);
+  console_add("history", historyCommand);
+}
+#endif
@@ -0,0 +1,197 @@
+/*
+  Latency trace - how long a headset reading takes to reach the strip.
+
+  Every good packet is followed from the UART to the LEDs. Each place it passes writes a
+  stamp (micros) into a trace ring, tagged with the player and the packet's number:
+
+    ARRIVED  the packet's checksum byte came in (the UART's data ready callback)
+    READ     the parser task read it from the UART driver             uart queue
+    PARSED   framed, checked and queued by the parser task            parse
+    INPUT    getInput() picked it up (dispatched at frame start)      frame wait
+    PUCK     drawPlayers() moved the puck with it (PLAY only)         render
+    SHOWN    FastLED.show() finished - it is on the strip             show
+
+  The parser task's stamps travel with the packet (Brain.h) and are written when loop() takes
+  it in. A writer claims a slot with an atomic add, writes the time, then the tag - a slot
+  being written has tag 0 and is skipped by the report.
+
+  The smoothing window is not a stamp - a rolling average of N packets lags the newest one by
+  (N - 1) / 2 packets - so the report works it out from the window and the measured time
+  between packets. The headset only sends attention once a second, so expect about 0.5 s of
+  waiting on the headset on top of everything here.
+
+  Serial console:  latency        - per hop mean / max of the traced packets, then clears
+*/
+#pragma once
+
+#include <Arduino.h>
+#include "config.h"
+#include "Brain.h"
+#include "settings.h"
+
+#define TRACE_SIZE 256   // events kept - a power of two
+
+enum TraceStage { TRACE_ARRIVED = 1, TRACE_READ, TRACE_PARSED, TRACE_INPUT, TRACE_PUCK, TRACE_SHOWN };
+#define TRACE_STAGES 7
+
+struct TraceEvent
+{
+  uint32_t us;
+  volatile uint32_t tag;   // stage | player << 8 | seq << 16 - 0 while being written
+};
+
+static TraceEvent traceRing[TRACE_SIZE];
+static uint32_t traceHead = 0;
+
+// per player: the newest packet loop() has taken in but not shown yet
+static uint16_t traceSeen[2] = {0, 0};
+static uint16_t tracePending[2] = {0, 0};
+static bool tracePendingOn[2] = {false, false};
+static bool tracePuckMoved = false;
+
+inline void trace(TraceStage stage, uint8_t player, uint16_t seq, uint32_t us)
+{
+  uint32_t slot = __atomic_fetch_add(&traceHead, 1, __ATOMIC_RELAXED) & (TRACE_SIZE - 1);
+  traceRing[slot].tag = 0;
+  traceRing[slot].us = us;
+  traceRing[slot].tag = stage | (player << 8) | ((uint32_t)seq << 16);
+}
+
+/** latency_packet()
+ *  loop() - a packet the brain has just consume()d (bt_dispatch() - serial_ap.h). Its parser
+ *  task stamps came with it.
+ */
+void latency_packet(uint8_t player, Brain& b)
+{
+  trace(TRACE_ARRIVED, player, b.consumedSeq, b.packetArrivalUs);
+  trace(TRACE_READ, player, b.consumedSeq, b.packetReadUs);
+  trace(TRACE_PARSED, player, b.consumedSeq, b.packetParsedUs);
+}
+
+/** latency_input()
+ *  loop() - in getInput(), when the players' values are read.
+ */
+void latency_input(Brain& a, Brain& b)
+{
+  Brain* brains[2] = {&a, &b};
+  uint32_t now = micros();
+  for (int p = 0; p < 2; p++)
+  {
+    uint16_t seq = brains[p]->consumedSeq;
+    if (seq == traceSeen[p])
+      continue;
+    traceSeen[p] = seq;
+    tracePending[p] = seq;
+    tracePendingOn[p] = true;
+    trace(TRACE_INPUT, p, seq, now);
+  }
+}
+
+/** latency_puck()
+ *  loop() - drawPlayers() has moved the puck.
+ */
+void latency_puck()
+{
+  uint32_t now = micros();
+  for (int p = 0; p < 2; p++)
+    if (tracePendingOn[p])
+      trace(TRACE_PUCK, p, tracePending[p], now);
+  tracePuckMoved = true;
+}
+
+/** latency_shown()
+ *  loop() - after FastLEDshowESP32() returns.
+ */
+void latency_shown()
+{
+  uint32_t now = micros();
+  for (int p = 0; p < 2; p++)
+  {
+    if (tracePendingOn[p] && tracePuckMoved)
+      trace(TRACE_SHOWN, p, tracePending[p], now);
+    tracePendingOn[p] = false;
+  }
+  tracePuckMoved = false;
+}
+
+struct HopStats
+{
+  uint32_t count;
+  uint64_t totalUs;
+  uint32_t maxUs;
+};
+
+void latencyCommand(char* arg1, char* arg2)
+{
+  static const char* hopNames[TRACE_STAGES] = {"", "", "uart queue", "parse", "frame wait", "render", "show"};
+
+  // copy the ring out first - the other core keeps writing to it
+  static TraceEvent events[TRACE_SIZE];
+  memcpy(events, traceRing, sizeof(events));
+
+  HopStats hops[TRACE_STAGES] = {};
+  HopStats total = {};
+  uint32_t packetGapUs = 0, packetGaps = 0;
+
+  for (int i = 0; i < TRACE_SIZE; i++)
+  {
+    if ((events[i].tag & 0xFF) != TRACE_ARRIVED)
+      continue;
+    uint32_t key = events[i].tag & 0xFFFF00; // player + seq
+    // the packet before this one from the same player - for the headset's packet rate
+    uint32_t prev = ((((key >> 16) - 1) & 0xFFFF) << 16) | (key & 0xFF00) | TRACE_ARRIVED;
+    uint32_t at[TRACE_STAGES] = {};
+    bool have[TRACE_STAGES] = {};
+    for (int j = 0; j < TRACE_SIZE; j++)
+    {
+      uint32_t tag = events[j].tag;
+      if (tag != 0 && (tag & 0xFFFF00) == key)
+      {
+        at[tag & 0xFF] = events[j].us;
+        have[tag & 0xFF] = true;
+      }
+      if (tag == prev && events[i].us - events[j].us < 5000000)
+      {
+        packetGapUs += events[i].us - events[j].us;
+        packetGaps++;
+      }
+    }
+    if (!have[TRACE_SHOWN])
+      continue; // not on the strip (yet, or the game was not in PLAY)
+    for (int s = TRACE_READ; s <= TRACE_SHOWN; s++)
+    {
+      uint32_t us = at[s] - at[s - 1];
+      hops[s].count++;
+      hops[s].totalUs += us;
+      if (us > hops[s].maxUs)
+        hops[s].maxUs = us;
+    }
+    uint32_t us = at[TRACE_SHOWN] - at[TRACE_ARRIVED];
+    total.count++;
+    total.totalUs += us;
+    if (us > total.maxUs)
+      total.maxUs = us;
+  }
+
+  if (total.count == 0)
+  {
+    logln("latency: no packets traced to the strip yet (needs a game in PLAY)");
+    return;
+  }
+  Serial.printf("latency over %u packets (mean / max us)\n", total.count);
+  for (int s = TRACE_READ; s <= TRACE_SHOWN; s++)
+    Serial.printf("  %-12s %8u %8u\n", hopNames[s], (uint32_t)(hops[s].totalUs / hops[s].count), hops[s].maxUs);
+  Serial.printf("  %-12s %8u %8u\n", "ours total", (uint32_t)(total.totalUs / total.count), total.maxUs);
+
+  uint32_t gap = packetGaps ? packetGapUs / packetGaps : 1000000;
+  Serial.printf("  smoothing    %8u          (%u packet window, packets every %u ms)\n",
+                (uint32_t)((averagingLength - 1) * (uint64_t)gap / 2), averagingLength, gap / 1000);
+  Serial.printf("  headset      %8u          (waiting for the next packet, on average)\n", gap / 2);
+
+  memset(traceRing, 0, sizeof(traceRing));
+}
+
+void latency_setup()
+{
+  console_add("latency", latencyCommand);
+}
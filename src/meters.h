@@ -0,0 +1,98 @@
+/*
+  Strength meters - the analog needle displays, one per player, driven by the LEDC hardware fader.
+
+  The game only tells a meter where to go: meter_set() with the player's value. When the value
+  changed, one fade command goes to the LEDC and the peripheral moves the duty there over
+  METER_FADE_MS on its own - no CPU work per frame, and the needle glides instead of jumping
+  once a second when a headset packet comes in. Duty is METER_RESOLUTION bits, not 8.
+
+  A fade has to finish before the next one is posted (the IDF driver would block loop() until
+  it did), so a value that changes mid fade goes out with the first call after the fade ends.
+  METER_FADE_MS is a bit shorter than the headset's one second packet interval, so normally
+  every change goes straight out.
+
+  In screensaver mode meter_pulse() swings the needles up and down - linear ramps done by the
+  fader, rather than the sine analogWrite() used to draw every frame.
+*/
+#pragma once
+
+#include <Arduino.h>
+#include <driver/ledc.h>
+#include "config.h"
+#include "fixmath.h"
+
+#define METER_COUNT 2                       // one per player
+#define METER_RESOLUTION LEDC_TIMER_13_BIT
+#define METER_DUTY_MAX ((1 << 13) - 1)
+#define METER_PWM_HZ 5000
+#define METER_FADE_MS 800
+#define METER_MODE LEDC_LOW_SPEED_MODE
+#define METER_TIMER LEDC_TIMER_3            // clear of the timers / channels analogWrite() hands out
+#define METER_FIRST_CHANNEL 6
+
+struct Meter
+{
+  uint8_t pin;
+  uint32_t duty;          // where the needle is going
+  unsigned long fadeEnd;  // millis() when the running fade is done
+  bool pulseUp;
+};
+
+static Meter meters[METER_COUNT] = {{led1Pin}, {led2Pin}};
+
+void meterFade(int m, uint32_t duty, uint16_t fadeMs, unsigned long millisNow)
+{
+  ledc_set_fade_time_and_start(METER_MODE, (ledc_channel_t)(METER_FIRST_CHANNEL + m), duty, fadeMs, LEDC_FADE_NO_WAIT);
+  meters[m].duty = duty;
+  meters[m].fadeEnd = millisNow + fadeMs;
+}
+
+/** meter_set()
+ *  Point meter m at a player's value (0..PLAYERMAX). Cheap to call every frame - only a change
+ *  is sent to the hardware.
+ */
+void meter_set(int m, int value, unsigned long millisNow)
+{
+  static constexpr FixMap toDuty(0, PLAYERMAX, 0, METER_DUTY_MAX);
+  uint32_t duty = constrain(toDuty(value), 0, METER_DUTY_MAX);
+  Meter& meter = meters[m];
+  if ((long)(millisNow - meter.fadeEnd) < 0 || duty == meter.duty)
+    return; // still fading - the next call after the fade picks the value up
+  meterFade(m, duty, METER_FADE_MS, millisNow);
+}
+
+/** meter_pulse()
+ *  Swing meter m full scale up and down, once every periodMs. Call every frame.
+ */
+void meter_pulse(int m, uint16_t periodMs, unsigned long millisNow)
+{
+  Meter& meter = meters[m];
+  if ((long)(millisNow - meter.fadeEnd) < 0)
+    return;
+  meter.pulseUp = !meter.pulseUp;
+  meterFade(m, meter.pulseUp ? METER_DUTY_MAX : 0, periodMs / 2, millisNow);
+}
+
+void meters_setup()
+{
+  ledc_timer_config_t timer = {};
+  timer.speed_mode = METER_MODE;
+  timer.duty_resolution = METER_RESOLUTION;
+  timer.timer_num = METER_TIMER;
+  timer.freq_hz = METER_PWM_HZ;
+  timer.clk_cfg = LEDC_AUTO_CLK;
+  ledc_timer_config(&timer);
+
+  for (int m = 0; m < METER_COUNT; m++)
+  {
+    ledc_channel_config_t channel = {};
+    channel.gpio_num = meters[m].pin;
+    channel.speed_mode = METER_MODE;
+    channel.channel = (ledc_channel_t)(METER_FIRST_CHANNEL + m);
+    channel.timer_sel = METER_TIMER;
+    channel.duty = 0; // off
+    ledc_channel_config(&channel);
+    meters[m].pulseUp = m & 1; // neighbours swing in opposite directions
+  }
+  ledc_fade_func_install(0);
+}
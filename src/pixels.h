@@ -0,0 +1,125 @@
+/*
+  Pixel pipeline - turns the finished leds[] into the bytes the strip is clocked with.
+
+  FastLED used to do this inside show(): scale every pixel by the global brightness and, for the
+  RGBW strip, pull the white channel out of it (setRgbw) - all on the show task while loop()
+  waits for it. Now pixels_convert() does it once per frame just before the show, with one
+  256 entry table that holds brightness and gamma together:
+
+    v = pixelLut[channel]              brightness + gamma, one lookup per channel
+    w = min(r, g, b); r -= w ...       RGBW strips - the white part goes to the white led
+    bytes written in the strip's colour order, W last (the RgbwDefault() layout)
+
+  The bytes go into wire[], which FastLED drives as a plain RGB strip (4/3 as long for RGBW)
+  at full brightness, so show() only clocks them out. With LED_GAMMA 1.0 and no dithering the
+  bytes are FastLED's own: the bench firmware ([env:bench], src/bench.h "pixels_vs_fastled")
+  compares them on the board against FastLED's scale8() and rgb_2_rgbw() exact colours.
+  tools/pixelbench times the conversion on the host.
+
+  Decision - no temporal dithering. FastLED dithered by default (the old setup never turned
+  it off): below full brightness it added a per frame offset to each channel before scaling,
+  so a dim colour alternated between the two levels either side of its true value and looked
+  like the level in between. That can't be done once a frame ahead of the show with a fixed
+  table, and at 60 fps the alternation itself shows as flicker on slow fades. So dithering is
+  off, and every frame gets the same rounded down level: at low brightness (and dim colours)
+  fades step more visibly and some colours come out slightly darker than before. This is a
+  change in the picture, accepted for the cheaper show; to undo it, drive leds[] through
+  FastLED again.
+
+  Only the conversion (pixelsBuildLut / pixelsConvert) is built on the host; the rest needs FastLED.
+*/
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <math.h>
+
+/** pixelsBuildLut()
+ *  Fill the table for a brightness (0..255, like FastLED.setBrightness) and a gamma (1.0 = linear).
+ *  Linear is the same as FastLED's scale8: (v * (brightness + 1)) >> 8.
+ */
+void pixelsBuildLut(uint8_t* lut, uint8_t brightness, float gamma)
+{
+  for (int v = 0; v < 256; v++)
+  {
+    int g = v;
+    if (gamma != 1.0f)
+      g = (int)(powf(v / 255.0f, gamma) * 255.0f + 0.5f);
+    lut[v] = (uint8_t)((g * (brightness + 1)) >> 8);
+  }
+}
+
+/** pixelsConvert()
+ *  count pixels of r,g,b bytes (CRGB layout) -> the strip's wire bytes.
+ *  order is the FastLED EOrder (octal - GRB is 0102), rgbw adds the white byte after the three colours.
+ */
+inline void pixelsConvert(const uint8_t* lut, const uint8_t* rgb, uint8_t* out, size_t count, uint16_t order, bool rgbw)
+{
+  const int c0 = (order >> 6) & 7, c1 = (order >> 3) & 7, c2 = order & 7;
+  for (size_t i = 0; i < count; i++, rgb += 3)
+  {
+    uint8_t v[3] = {lut[rgb[0]], lut[rgb[1]], lut[rgb[2]]};
+    if (rgbw)
+    {
+      uint8_t w = v[0] < v[1] ? v[0] : v[1];
+      if (v[2] < w)
+        w = v[2];
+      v[0] -= w; v[1] -= w; v[2] -= w;
+      out[3] = w;
+    }
+    out[0] = v[c0];
+    out[1] = v[c1];
+    out[2] = v[c2];
+    out += rgbw ? 4 : 3;
+  }
+}
+
+#ifdef ARDUINO
+#include <Arduino.h>
+#include <FastLED.h>
+#include "config.h"
+
+extern CRGB* leds;   // the strip being drawn (arena.h)
+
+#define WIRE_BYTES (NUM_LEDS * (variant.rgbw ? 4 : 3))
+#define WIRE_PIXELS ((WIRE_BYTES + 2) / 3)   // what FastLED is told the strip length is
+
+static CRGB wire[TUG_ARENAS][WIRE_PIXELS];   // one LED output per arena
+static uint8_t pixelLut[256];   // brightness + gamma
+
+// brightness changed (settings, new game) - rebuild the table
+void pixels_set_brightness(uint8_t brightness)
+{
+  pixelsBuildLut(pixelLut, brightness, LED_GAMMA);
+}
+
+// blank the frame - what FastLED.clear() did when FastLED drove leds[] itself
+inline void clearFrame()
+{
+  fill_solid(leds, led_count, CRGB::Black);
+}
+
+/** pixels_convert()
+ *  Once per frame for each LED output, after its frame is drawn and before FastLEDshowESP32().
+ */
+void pixels_convert(int output = 0)
+{
+  pixelsConvert(pixelLut, (const uint8_t*)leds, (uint8_t*)wire[output], NUM_LEDS, variant.colourOrder, variant.rgbw);
+}
+
+/** pixels_setup()
+ *  Registers wire[] with FastLED - it clocks the bytes out as they are, so no brightness,
+ *  colour correction, dithering or RGBW conversion there. Dithering off is the decision at
+ *  the top of this file.
+ */
+void pixels_setup()
+{
+  FastLED.addLeds<WS2812, FASTLED_DATA_PIN, RGB>(wire[0], WIRE_PIXELS);
+#if TUG_ARENAS > 1
+  FastLED.addLeds<WS2812, ARENA2_DATA_PIN, RGB>(wire[1], WIRE_PIXELS); // both go out in one show, in parallel (RMT)
+#endif
+  FastLED.setBrightness(255);
+  FastLED.setDither(DISABLE_DITHER);
+  pixels_set_brightness(led_brightness);
+}
+#endif
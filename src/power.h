@@ -0,0 +1,176 @@
+/*
+  Idle power policy - for units left on a battery pack between sessions.
+
+  When nobody is playing (SCREENSAVER, or CALIBRATE with neither headset on) the game goes idle:
+    - frames drop from FRAME_RATE to IDLE_FRAME_RATE (the attract effects don't need 60)
+    - the CPU clock is allowed down to IDLE_CPU_MHZ, and to light sleep between frames
+      (ESP-IDF power management: dynamic frequency scaling + automatic light sleep)
+    - the SerialAB task stops polling every millisecond and sleeps until a UART says bytes came in
+  The headset RX pins are light sleep wake up sources (a start bit pulls the line low), so a
+  headset being switched on wakes the chip. The first packet it sends wakes loop() at once
+  (power_wake() runs the next frame straight away), which goes back to full rate - so the
+  game is at full speed within one frame of a headset appearing. The byte that woke the chip
+  is usually lost; the headset repeats its packets, so that costs one packet.
+
+  Twin and Bluetooth builds only drop the frame rate - see POWER_CLOCK_DROP.
+
+  Power management needs CONFIG_PM_ENABLE (and CONFIG_FREERTOS_USE_TICKLESS_IDLE for the
+  light sleep) in the IDF build. Without them the CPU clock is just switched with
+  setCpuFrequencyMhz() and the chip does not sleep.
+
+  Serial console:  power   - idle or active, CPU clock, frame rate, the time spent in each and
+                             how busy loop() was in each (its share of the wall clock)
+  Comparing the two: the loop() share from "power" (or "tasks" for the core load), and a USB
+  power meter read once in a game and once in the screensaver - the current has to be
+  measured on the board.
+*/
+#pragma once
+
+#include <Arduino.h>
+#include <driver/gpio.h>
+#include <esp_sleep.h>
+#ifdef CONFIG_PM_ENABLE
+  #include <esp_pm.h>
+#endif
+#include "config.h"
+#include "scheduler.h"
+#include "settings.h"
+
+#define POWER_IDLE_POLL_MS 100   // longest the SerialAB task sleeps when idle with no bytes coming
+
+// The twin build's headsets C and D are software UARTs: their bits are timed off the CPU clock
+// and their pins are plain GPIO interrupts, not wake up sources - so a clock drop or a light
+// sleep would lose their bytes, and arena 2 could never wake the board on its own. Those
+// builds keep the full clock and never light sleep when idle; only the frame rate drops.
+// So does the Bluetooth build ([env:bt]) - a light sleep would drop headset A's SPP link.
+#if TUG_ARENAS > 1 || defined(TUG_BLUETOOTH)
+  #define POWER_CLOCK_DROP 0
+#else
+  #define POWER_CLOCK_DROP 1
+#endif
+
+static volatile bool powerIdle = false;
+static unsigned long powerSince = 0;
+static unsigned long powerIdleMs = 0;
+static unsigned long powerActiveMs = 0;
+static uint64_t powerBusySince = 0;     // frameBusyTotalUs at the last change
+static uint64_t powerIdleBusyUs = 0;    // loop() time spent in frames while idle
+static uint64_t powerActiveBusyUs = 0;  // ... and while active
+static uint32_t powerFullMhz = 240;     // the CPU clock at boot - what active goes back to
+#ifdef CONFIG_PM_ENABLE
+static esp_pm_lock_handle_t powerFullSpeed = NULL;   // held while active - full clock, no sleep
+static esp_pm_lock_handle_t powerNoSleep = NULL;     // held for good when !POWER_CLOCK_DROP
+#endif
+
+inline bool power_idle()
+{
+  return powerIdle;
+}
+
+/** power_wake()
+ *  SerialAB task - a headset packet came in. If idle, run loop() now so it can notice.
+ */
+void power_wake()
+{
+  if (powerIdle)
+    scheduler_now();
+}
+
+/** power_tick()
+ *  Once per frame, with whether anyone is playing.
+ */
+void power_tick(bool idle, unsigned long millisNow)
+{
+  if (idle == powerIdle)
+    return;
+  if (powerIdle)
+  {
+    powerIdleMs += millisNow - powerSince;
+    powerIdleBusyUs += frameBusyTotalUs - powerBusySince;
+  }
+  else
+  {
+    powerActiveMs += millisNow - powerSince;
+    powerActiveBusyUs += frameBusyTotalUs - powerBusySince;
+  }
+  powerSince = millisNow;
+  powerBusySince = frameBusyTotalUs;
+  powerIdle = idle;
+
+  if (idle)
+  {
+    scheduler_set_interval(1000000 / IDLE_FRAME_RATE);
+#if !POWER_CLOCK_DROP
+    // software UARTs - full clock, no sleep (see POWER_CLOCK_DROP)
+#elif defined(CONFIG_PM_ENABLE)
+    esp_pm_lock_release(powerFullSpeed);
+#else
+    setCpuFrequencyMhz(IDLE_CPU_MHZ);
+#endif
+    logln("idle - low power");
+  }
+  else
+  {
+#if !POWER_CLOCK_DROP
+    // nothing was dropped
+#elif defined(CONFIG_PM_ENABLE)
+    esp_pm_lock_acquire(powerFullSpeed);
+#else
+    setCpuFrequencyMhz(powerFullMhz);
+#endif
+    scheduler_set_interval(FRAME_INTERVAL_US);
+    logln("active - full speed");
+  }
+}
+
+// loop()'s share of the wall clock, in tenths of a percent
+inline uint32_t powerBusyPermille(uint64_t busyUs, unsigned long ms)
+{
+  return ms ? (uint32_t)(busyUs / ms) : 0;
+}
+
+void powerCommand(char* arg1, char* arg2)
+{
+  unsigned long now = millis();
+  uint64_t busyNow = frameBusyTotalUs - powerBusySince;
+  unsigned long idleMs = powerIdleMs + (powerIdle ? now - powerSince : 0);
+  unsigned long activeMs = powerActiveMs + (powerIdle ? 0 : now - powerSince);
+  uint32_t idleBusy = powerBusyPermille(powerIdleBusyUs + (powerIdle ? busyNow : 0), idleMs);
+  uint32_t activeBusy = powerBusyPermille(powerActiveBusyUs + (powerIdle ? 0 : busyNow), activeMs);
+  Serial.printf("%s, CPU %u MHz, %u fps, idle %lu s (loop %u.%u%%), active %lu s (loop %u.%u%%)",
+                powerIdle ? "idle" : "active", getCpuFrequencyMhz(), 1000000 / frameIntervalUs,
+                idleMs / 1000, idleBusy / 10, idleBusy % 10, activeMs / 1000, activeBusy / 10, activeBusy % 10);
+#ifdef CONFIG_PM_ENABLE
+  Serial.println(", DFS + light sleep");
+#else
+  Serial.println(", no IDF power management - clock switching only");
+#endif
+}
+
+/** power_setup()
+ *  pins - the headset UART RX pins, to wake from light sleep.
+ */
+void power_setup(const int* rxPins, int count)
+{
+  powerFullMhz = getCpuFrequencyMhz();
+#ifdef CONFIG_PM_ENABLE
+  esp_pm_config_esp32_t pm = {};
+  pm.max_freq_mhz = powerFullMhz;
+  pm.min_freq_mhz = IDLE_CPU_MHZ;
+  pm.light_sleep_enable = true;
+  esp_pm_configure(&pm);
+  esp_pm_lock_create(ESP_PM_CPU_FREQ_MAX, 0, "active", &powerFullSpeed);
+  esp_pm_lock_acquire(powerFullSpeed); // start active
+#if !POWER_CLOCK_DROP
+  esp_pm_lock_create(ESP_PM_NO_LIGHT_SLEEP, 0, "swuart", &powerNoSleep);
+  esp_pm_lock_acquire(powerNoSleep); // never released - power_tick() keeps powerFullSpeed too
+#endif
+#endif
+  for (int i = 0; i < count; i++)
+    gpio_wakeup_enable((gpio_num_t)rxPins[i], GPIO_INTR_LOW_LEVEL); // UART idles high - a start bit wakes us
+  esp_sleep_enable_gpio_wakeup();
+
+  powerSince = millis();
+  powerBusySince = frameBusyTotalUs;
+  console_add("power", powerCommand);
+}
@@ -0,0 +1,170 @@
+/*
+  Input predictor - a smooth, up to date drive value for each player on every frame.
+
+  The headsets send attention once a second, and getAverage() - the mean of the last
+  averagingLength packets, held until the next one - runs a couple of seconds behind the
+  player and moves the bars in steps. The predictor keeps a constant velocity alpha-beta
+  filter per headset instead:
+    - at each packet (stamped with when it arrived): predict the value at that time from the
+      last estimate and rate, then pull the estimate alpha and the rate beta of the way
+      towards what the packet says
+    - every frame: extrapolate from the last packet along the rate - for at most
+      PREDICT_HORIZON_MS, so a late packet doesn't send the value off - and move the output
+      towards that by at most PREDICT_SLEW a second, so a packet's correction is spread
+      over a few frames rather than a jump
+  How much a packet is trusted follows the headset's own signal quality (the
+  signalQualityNotEstimated byte): a perfect signal moves the filter alpha / beta, an
+  estimated attention (Brain.cpp) moves it less the worse the signal, and "nobody there"
+  (quality at the gate) drops the player to 0 as getAverage() does.
+
+  Fixed point: values and rates are in 1/256ths (PREDICT_ONE) of an attention point.
+  Measured against getAverage() in tools/predictcheck (synthetic matches, or "history dump"
+  captures). The gains were swept on its tuning set and checked on its held out set, where
+  the gain is small: the predictor is about 350 ms less behind the player than the average
+  (2.2 s against 2.6 s), with slightly fewer puck reversals (3.12 against 3.16 a minute) and
+  far smaller frame steps (1 point against 16), but its error once lined up with the player
+  is worse (6.0 against 4.8 points) - it follows the packet noise a little more. Faster
+  gains cut much more lag (to about 1.1 s) but make the puck change direction half as often
+  again, so they were not used. Not yet checked on real captures.
+  Switch it off with the "predict" setting to go back to getAverage().
+*/
+#pragma once
+
+#include <stdint.h>
+
+#define PREDICT_ONE 256
+#define PREDICT_ALPHA 96           // /256 - share of a perfect packet's surprise taken into the value
+#define PREDICT_BETA 8             // /256 - ... and into the rate
+#define PREDICT_MIN_CONFIDENCE 64  // /256 - trust in a packet with the worst estimated signal
+#define PREDICT_HORIZON_MS 200     // extrapolate no further than this past the last packet
+#define PREDICT_STALE_MS 5000      // a packet after a gap this long starts the filter again
+#define PREDICT_MAX_RATE 30        // attention points a second, either way
+#define PREDICT_SLEW 40            // the output moves at most this many points a second
+#define PREDICT_MAX 100            // PLAYERMAX
+
+struct Predictor
+{
+  int32_t x;              // estimate at sampleMs
+  int32_t v;              // rate - per second
+  uint32_t sampleMs;      // when the last packet arrived
+  int32_t out;            // what the game gets
+  uint32_t outMs;         // when out was last moved
+  bool primed;            // had a packet
+};
+
+inline int32_t predictClamp(int32_t v, int32_t lo, int32_t hi)
+{
+  return v < lo ? lo : v > hi ? hi : v;
+}
+
+void predictorReset(Predictor& p, int32_t value, uint32_t ms)
+{
+  p.x = p.out = value * PREDICT_ONE;
+  p.v = 0;
+  p.sampleMs = p.outMs = ms;
+  p.primed = true;
+}
+
+// how far to trust a packet - 256 for a perfect signal down to PREDICT_MIN_CONFIDENCE near the gate, 0 = nobody
+inline int32_t predictConfidence(uint8_t quality, uint8_t gate)
+{
+  if (quality >= gate)
+    return 0;
+  if (quality == 0)
+    return 256;
+  return PREDICT_MIN_CONFIDENCE + (256 - PREDICT_MIN_CONFIDENCE) * (gate - quality) / gate;
+}
+
+/** predictorSample()
+ *  A packet - value (0..PREDICT_MAX), the headset's own signal quality, the quality gate, and
+ *  when the packet arrived (ms).
+ */
+void predictorSample(Predictor& p, uint8_t value, uint8_t quality, uint8_t gate, uint32_t ms)
+{
+  int32_t c = predictConfidence(quality, gate);
+  if (c == 0)
+  {// nobody there - as getAverage() after the average is cleared
+    predictorReset(p, 0, ms);
+    p.primed = false;
+    return;
+  }
+  int32_t dt = (int32_t)(ms - p.sampleMs);
+  if (!p.primed)
+  {
+    predictorReset(p, value, ms);
+    return;
+  }
+  if (dt > PREDICT_STALE_MS)
+  {// the headset went quiet - start the filter again, the output slews across
+    p.x = value * PREDICT_ONE;
+    p.v = 0;
+    p.sampleMs = ms;
+    return;
+  }
+  if (dt < 1)
+    dt = 1;
+
+  int32_t predicted = p.x + p.v * dt / 1000;
+  int32_t r = value * PREDICT_ONE - predicted;
+  int32_t alpha = PREDICT_ALPHA * c / 256;
+  int32_t beta = PREDICT_BETA * c / 256;
+  p.x = predictClamp(predicted + alpha * r / 256, 0, PREDICT_MAX * PREDICT_ONE);
+  p.v = predictClamp(p.v + beta * r / 256 * 1000 / dt, -PREDICT_MAX_RATE * PREDICT_ONE, PREDICT_MAX_RATE * PREDICT_ONE);
+  p.sampleMs = ms;
+}
+
+/** predictorTick()
+ *  Once a frame - moves the output on to ms and returns it (0..PREDICT_MAX).
+ */
+int predictorTick(Predictor& p, uint32_t ms)
+{
+  if (!p.primed)
+  {
+    p.outMs = ms;
+    return (p.out + PREDICT_ONE / 2) / PREDICT_ONE;
+  }
+  int32_t age = (int32_t)(ms - p.sampleMs);
+  age = predictClamp(age, 0, PREDICT_HORIZON_MS);
+  int32_t target = predictClamp(p.x + p.v * age / 1000, 0, PREDICT_MAX * PREDICT_ONE);
+
+  int32_t step = PREDICT_SLEW * PREDICT_ONE * predictClamp((int32_t)(ms - p.outMs), 0, 1000) / 1000;
+  p.out += predictClamp(target - p.out, -step, step);
+  p.outMs = ms;
+  return (p.out + PREDICT_ONE / 2) / PREDICT_ONE;
+}
+
+#ifdef ARDUINO
+#include <Arduino.h>
+#include "config.h"
+#include "Brain.h"
+#include "settings.h"
+
+static Predictor predictor[HEADSET_COUNT];
+static uint8_t predictValue[HEADSET_COUNT];  // this frame's output
+
+/** predict_packet()
+ *  loop() - a packet the brain has just consume()d (bt_dispatch() - serial_ap.h).
+ */
+void predict_packet(int headset, const Brain& b, unsigned long millisNow)
+{
+  // stamp it when it arrived, not this frame - micros() wraps, so as an age
+  uint32_t ageMs = (micros() - b.packetArrivalUs) / 1000;
+  predictorSample(predictor[headset], b.attention, b.signalQualityNotEstimated, qualityGate, millisNow - ageMs);
+}
+
+/** predict_tick()
+ *  Once per frame, after the packets are dispatched and before the arenas read their players -
+ *  moves every headset's output on.
+ */
+void predict_tick(unsigned long millisNow)
+{
+  for (int h = 0; h < HEADSET_COUNT; h++)
+    predictValue[h] = predictorTick(predictor[h], millisNow);
+}
+
+// the player's drive value for this frame
+inline uint8_t predict_value(int headset)
+{
+  return predictValue[headset];
+}
+#endif
@@ -0,0 +1,160 @@
+/*
+  Headset presence - is a headset there, and is it on someone's head?
+
+    PRESENCE_UNPLUGGED    no good packets coming in (cable out, headset off, or line noise)
+    PRESENCE_NO_CONTACT   packets coming in, but the sensor is not on the skin
+    PRESENCE_GOOD         packets coming in with a usable signal
+
+  Worked out every frame from the link activity the parser counts (Brain.h) rather than from
+  the 1 Hz signal quality byte alone:
+    - unplugged: no good packets for PRESENCE_MISSED_PACKETS of the headset's own packet
+      interval (learned as packets come in), and never less than PRESENCE_SILENT_MS. A headset
+      streaming raw samples (512 a second) is spotted within PRESENCE_SILENT_MS; one sending
+      only the 1 Hz packets within two seconds. Bytes without good packets (a floating RX pin,
+      the wrong baud rate) do not count as a headset.
+    - contact: when raw samples are streaming, from those - a sensor off the skin drives the
+      input to the rails, so mostly railed samples since the last frame = no contact. Without
+      raw samples, from the signal quality of the last packet (after the estimate - Brain.cpp).
+  Before, an unplugged headset kept its last signal quality until a packet said otherwise -
+  which never came.
+
+  Serial console:  presence  - state, packet interval, and the link rates since the last look.
+*/
+#pragma once
+
+#include <Arduino.h>
+#include "config.h"
+#include "Brain.h"
+#include "settings.h"
+
+enum Presence
+{
+  PRESENCE_UNPLUGGED,
+  PRESENCE_NO_CONTACT,
+  PRESENCE_GOOD
+};
+
+const char* presenceNames[] = {"unplugged", "no contact", "good"};
+
+struct HeadsetPresence
+{
+  Presence state;
+  uint16_t packetSeq;         // Brain::packetSeq at the last tick
+  uint32_t rawSeen;           // Brain::rawSeen / rawRailed at the last tick
+  uint32_t rawRailed;
+  unsigned long lastPacketMs; // when the latest good packet was seen
+  unsigned long lastRawMs;    // when the latest raw samples were seen
+  unsigned long intervalMs;   // the headset's packet interval, smoothed
+  unsigned long since;        // when the state last changed
+  // for the console - counts when it last looked
+  uint32_t shownBytes, shownSyncs, shownRaw;
+  uint16_t shownPackets;
+  unsigned long shownMs;
+};
+
+static HeadsetPresence presence[HEADSET_COUNT];
+extern Brain* headsets[HEADSET_COUNT];   // serial_ap.h
+
+inline Presence presence_of(int headset)
+{
+  return presence[headset].state;
+}
+
+// both of an arena's headsets on someone's head
+inline bool presence_both_good(int a)
+{
+  return presence[2 * a].state == PRESENCE_GOOD && presence[2 * a + 1].state == PRESENCE_GOOD;
+}
+
+// either of an arena's headsets in this state
+inline bool presence_any(int a, Presence state)
+{
+  return presence[2 * a].state == state || presence[2 * a + 1].state == state;
+}
+
+Presence presenceUpdate(HeadsetPresence& p, const Brain& brain, unsigned long millisNow)
+{
+  uint16_t packets = brain.packetSeq - p.packetSeq;
+  uint32_t raw = brain.rawSeen - p.rawSeen;
+  uint32_t railed = brain.rawRailed - p.rawRailed;
+  p.packetSeq = brain.packetSeq;
+  p.rawSeen = brain.rawSeen;
+  p.rawRailed = brain.rawRailed;
+
+  unsigned long timeout = _max((unsigned long)PRESENCE_SILENT_MS, PRESENCE_MISSED_PACKETS * p.intervalMs);
+  if (packets > 0)
+  {
+    // learn the rate only from a headset that was streaming - the gap of an unplug is not an
+    // interval, and would stretch the next unplug's timeout for a dozen packets
+    unsigned long gap = millisNow - p.lastPacketMs;
+    if (p.lastPacketMs != 0 && p.state != PRESENCE_UNPLUGGED && gap <= timeout)
+    {
+      unsigned long interval = gap / packets;
+      p.intervalMs = (p.intervalMs * 3 + interval) / 4; // smooth - a late packet won't halve the timeout
+      timeout = _max((unsigned long)PRESENCE_SILENT_MS, PRESENCE_MISSED_PACKETS * p.intervalMs);
+    }
+    p.lastPacketMs = millisNow;
+  }
+
+  if (p.lastPacketMs == 0 || millisNow - p.lastPacketMs > timeout)
+    return PRESENCE_UNPLUGGED;
+
+  if (raw > 0)
+  {
+    p.lastRawMs = millisNow;
+    return railed * 2 > raw ? PRESENCE_NO_CONTACT : PRESENCE_GOOD;
+  }
+  if (p.lastRawMs != 0 && millisNow - p.lastRawMs < PRESENCE_SILENT_MS)
+    return p.state; // streaming, just no samples this frame - keep the raw verdict
+  return brain.signalQuality == 0 ? PRESENCE_GOOD : PRESENCE_NO_CONTACT;
+}
+
+/** presence_tick()
+ *  Once per frame, before the stage logic.
+ */
+void presence_tick(unsigned long millisNow)
+{
+  for (int i = 0; i < HEADSET_COUNT; i++)
+  {
+    HeadsetPresence& p = presence[i];
+    Presence now = presenceUpdate(p, *headsets[i], millisNow);
+    if (now != p.state)
+    {
+      Serial.printf("Headset %s: %s -> %s\n", headsets[i]->sName, presenceNames[p.state], presenceNames[now]);
+      p.state = now;
+      p.since = millisNow;
+    }
+  }
+}
+
+void presenceCommand(char* arg1, char* arg2)
+{
+  unsigned long now = millis();
+  for (int i = 0; i < HEADSET_COUNT; i++)
+  {
+    HeadsetPresence& p = presence[i];
+    const Brain& b = *headsets[i];
+    unsigned long ms = _max(now - p.shownMs, 1UL);
+    Serial.printf("%s: %s for %lu ms, packet every %lu ms, last %lu ms ago\n", b.sName, presenceNames[p.state],
+                  now - p.since, p.intervalMs, p.lastPacketMs ? now - p.lastPacketMs : 0);
+    Serial.printf("   bytes %lu/s, syncs %lu/s, packets %lu/s, raw %lu/s (latest %d)\n",
+                  (b.bytesSeen - p.shownBytes) * 1000UL / ms, (b.syncsSeen - p.shownSyncs) * 1000UL / ms,
+                  (uint16_t)(b.packetSeq - p.shownPackets) * 1000UL / ms, (b.rawSeen - p.shownRaw) * 1000UL / ms,
+                  b.rawValue);
+    p.shownBytes = b.bytesSeen;
+    p.shownSyncs = b.syncsSeen;
+    p.shownPackets = b.packetSeq;
+    p.shownRaw = b.rawSeen;
+    p.shownMs = now;
+  }
+}
+
+void presence_setup()
+{
+  for (int i = 0; i < HEADSET_COUNT; i++)
+  {
+    presence[i].state = PRESENCE_UNPLUGGED;
+    presence[i].intervalMs = 1000; // a 1 Hz headset until the packets say otherwise
+  }
+  console_add("presence", presenceCommand);
+}
@@ -0,0 +1,342 @@
+/*
+  Match recorder - writes a small per-frame trace of every match to flash (LittleFS).
+
+  A match is recorded from the end of the countdown (PLAY) until the explosion has
+  finished (DEAD) - or until the headsets drop out. The last REC_FILES matches are kept,
+  oldest is overwritten.
+
+  loop() never waits on flash: each frame is encoded into a 64 byte chunk, full chunks are
+  posted to a queue and a low priority task on core 0 does the file writes. If the queue is
+  ever full the chunk is dropped (counted) and the next frame is a keyframe so the rest of
+  the match still decodes. The open and close chunks must not be dropped - without the
+  header the file can't be decoded, and without the close its tail is never written - so
+  data chunks never take the last REC_RESERVED_SLOTS places in the queue, and an open and
+  a close always fit without loop() waiting.
+
+  File format (all little endian):
+    header   'T','U','G','R', version, qualityGate, frame interval ms, 0,
+             match seed (4 bytes - rng_seed() for the game, so a replay draws the same
+             explosion, sparkle and sound detune; not in version 1 files)
+    frames   one flags byte then, for each bit set, in this order:
+               REC_DT       varint  ms since the previous frame (only sent when it changes)
+               REC_STAGE    byte    stage number (only sent when it changes)
+               REC_A        zigzag varint delta of playerA
+               REC_B        zigzag varint delta of playerB
+               REC_PUCK     zigzag varint delta of puckPosition
+               REC_QA       zigzag varint delta of brainA raw signal quality
+               REC_QB       zigzag varint delta of brainB raw signal quality
+             REC_KEY means the values are absolute rather than deltas.
+  A frame where nothing changed is a single 0 byte.
+
+  Serial console:  rec  - list recordings     rec dump <n>  - hex dump of recording n
+  tools/recdecode turns the hex dump (or a raw file) into CSV.
+*/
+#pragma once
+
+#include <Arduino.h>
+#include <LittleFS.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/queue.h>
+#include "config.h"
+#include "sound.h"
+#include "settings.h"
+#include "tasks.h"
+#include "rng.h"
+
+#define REC_FILES 8               // matches kept in flash
+#define REC_CHUNK_DATA 62
+#define REC_QUEUE_LEN 16          // chunks waiting for the writer (~1 second of play)
+#define REC_RESERVED_SLOTS 2      // kept free of data chunks - a close and the next open
+#define REC_WRITE_BUFFER 1024     // writer batches this much before touching flash
+#define REC_KEYFRAME_EVERY 256    // frames
+#define REC_VERSION 2             // 2 - the match seed in the header
+
+#define REC_DT    0x01
+#define REC_STAGE 0x02
+#define REC_A     0x04
+#define REC_B     0x08
+#define REC_PUCK  0x10
+#define REC_QA    0x20
+#define REC_QB    0x40
+#define REC_KEY   0x80
+
+enum RecChunkType : uint8_t { REC_OPEN, REC_DATA, REC_CLOSE };
+
+struct RecChunk
+{
+  RecChunkType type;
+  uint8_t len;
+  uint8_t data[REC_CHUNK_DATA];
+};
+
+struct RecFrame
+{
+  uint8_t stage;
+  int16_t playerA;
+  int16_t playerB;
+  int16_t puck;
+  uint8_t qualityA;
+  uint8_t qualityB;
+};
+
+static QueueHandle_t recQueue = NULL;
+static TaskHandle_t recTaskHandle = NULL;
+static volatile bool recOk = false;   // file system mounted and the writer running
+static bool recActive = false;        // a match is being recorded
+static bool recKeyframe = true;       // next frame is sent with absolute values
+static uint16_t recFrameCount = 0;
+static unsigned long recLastMillis = 0;
+static uint16_t recLastDt = 0;
+static RecFrame recLast;
+static RecChunk recChunk;
+static uint8_t recNext = 0;           // next file in the ring
+static uint32_t recDropped = 0;       // chunks lost because the writer fell behind
+
+void recPath(char* buf, uint8_t n)
+{
+  sprintf(buf, "/rec%u.bin", n);
+}
+
+// -------- writer task (core 0) ---------
+static uint8_t recWriteBuf[REC_WRITE_BUFFER];
+static uint16_t recWriteLen = 0;
+
+void recFlush(File& f)
+{
+  if (recWriteLen == 0 || !f)
+    return;
+  sound_pause(); // flash write - keep the sound interrupt out of the way
+  f.write(recWriteBuf, recWriteLen);
+  sound_resume();
+  recWriteLen = 0;
+}
+
+void recorderTask(void *pvParameters)
+{
+  File f;
+  RecChunk chunk;
+  char path[16];
+  for (;;)
+  {
+    if (xQueueReceive(recQueue, &chunk, portMAX_DELAY) != pdTRUE)
+      continue;
+
+    if (chunk.type == REC_OPEN)
+    {
+      if (f)
+        f.close();
+      recPath(path, recNext);
+      recNext = (recNext + 1) % REC_FILES;
+      sound_pause();
+      f = LittleFS.open(path, "w");
+      File idx = LittleFS.open("/recnext", "w");
+      if (idx)
+      {
+        idx.write(recNext);
+        idx.close();
+      }
+      sound_resume();
+      recWriteLen = 0;
+    }
+
+    if (chunk.len > 0)
+    {
+      if (recWriteLen + chunk.len > REC_WRITE_BUFFER)
+        recFlush(f);
+      memcpy(recWriteBuf + recWriteLen, chunk.data, chunk.len);
+      recWriteLen += chunk.len;
+    }
+
+    if (chunk.type == REC_CLOSE && f)
+    {
+      recFlush(f);
+      sound_pause();
+      f.close();
+      sound_resume();
+    }
+  }
+}
+
+// -------- encoder (loop) ---------
+// post the current chunk to the writer - never blocks. Data leaves the reserved slots for open and close.
+void recPost(RecChunkType type)
+{
+  recChunk.type = type;
+  bool room = type != REC_DATA || uxQueueSpacesAvailable(recQueue) > REC_RESERVED_SLOTS;
+  if (!room || xQueueSend(recQueue, &recChunk, 0) != pdTRUE)
+  {
+    recDropped++;
+    recKeyframe = true; // deltas would be against values the decoder never saw
+  }
+  recChunk.len = 0;
+}
+
+void recPutByte(uint8_t b)
+{
+  recChunk.data[recChunk.len++] = b;
+}
+
+void recPutVarint(uint32_t v)
+{
+  while (v >= 0x80)
+  {
+    recPutByte((uint8_t)(v | 0x80));
+    v >>= 7;
+  }
+  recPutByte((uint8_t)v);
+}
+
+void recPutSigned(int32_t v)
+{
+  recPutVarint(((uint32_t)v << 1) ^ (uint32_t)(v >> 31)); // zigzag - small negatives stay small
+}
+
+void recorderBegin(unsigned long millisNow)
+{
+  recChunk.len = 0;
+  recPutByte('T'); recPutByte('U'); recPutByte('G'); recPutByte('R');
+  recPutByte(REC_VERSION);
+  recPutByte(qualityGate);
+  recPutByte((uint8_t)(FRAME_INTERVAL_US / 1000));
+  recPutByte(0);
+  for (int i = 0; i < 4; i++)
+    recPutByte((uint8_t)(rngSeedUsed >> (8 * i)));
+  recPost(REC_OPEN);
+
+  recActive = true;
+  recKeyframe = true;
+  recFrameCount = 0;
+  recLastMillis = millisNow;
+  recLastDt = 0;
+}
+
+void recorderEnd()
+{
+  recPost(REC_CLOSE);
+  recActive = false;
+}
+
+void recorderFrame(unsigned long millisNow, const RecFrame& fr)
+{
+  if (recChunk.len > REC_CHUNK_DATA - 24) // worst case frame is 22 bytes
+    recPost(REC_DATA);
+
+  if (recFrameCount++ % REC_KEYFRAME_EVERY == 0)
+    recKeyframe = true;
+
+  uint16_t dt = (uint16_t)(millisNow - recLastMillis);
+  recLastMillis = millisNow;
+
+  uint8_t flags = 0;
+  if (recKeyframe)
+    flags = REC_KEY | REC_DT | REC_STAGE | REC_A | REC_B | REC_PUCK | REC_QA | REC_QB;
+  else
+  {
+    if (dt != recLastDt) flags |= REC_DT;
+    if (fr.stage != recLast.stage) flags |= REC_STAGE;
+    if (fr.playerA != recLast.playerA) flags |= REC_A;
+    if (fr.playerB != recLast.playerB) flags |= REC_B;
+    if (fr.puck != recLast.puck) flags |= REC_PUCK;
+    if (fr.qualityA != recLast.qualityA) flags |= REC_QA;
+    if (fr.qualityB != recLast.qualityB) flags |= REC_QB;
+  }
+  // a keyframe is a delta against zero
+  if (recKeyframe)
+    memset(&recLast, 0, sizeof(recLast));
+
+  recPutByte(flags);
+  if (flags & REC_DT) recPutVarint(dt);
+  if (flags & REC_STAGE) recPutByte(fr.stage);
+  if (flags & REC_A) recPutSigned(fr.playerA - recLast.playerA);
+  if (flags & REC_B) recPutSigned(fr.playerB - recLast.playerB);
+  if (flags & REC_PUCK) recPutSigned(fr.puck - recLast.puck);
+  if (flags & REC_QA) recPutSigned((int)fr.qualityA - recLast.qualityA);
+  if (flags & REC_QB) recPutSigned((int)fr.qualityB - recLast.qualityB);
+
+  recLast = fr;
+  recLastDt = dt;
+  recKeyframe = false;
+}
+
+/** recorder_tick()
+ *  Call once per frame after the stage has been drawn. Starts and stops recording
+ *  on the stage changes and encodes the frame.
+ *  recording - true while a match is in progress (PLAY or DEAD)
+ */
+void recorder_tick(unsigned long millisNow, bool recording, const RecFrame& fr)
+{
+  if (!recOk)
+    return;
+  if (recording && !recActive)
+    recorderBegin(millisNow);
+  if (recActive)
+  {
+    if (recording)
+      recorderFrame(millisNow, fr);
+    else
+      recorderEnd();
+  }
+}
+
+// -------- console ---------
+void recorderCommand(char* arg1, char* arg2)
+{
+  char path[16];
+  if (arg1 != NULL && strcmp(arg1, "dump") == 0 && arg2 != NULL)
+  {
+    recPath(path, atoi(arg2) % REC_FILES);
+    File f = LittleFS.open(path, "r");
+    if (!f)
+    {
+      logln("ERROR: no such recording");
+      return;
+    }
+    Serial.printf("REC %s %u\n", path, (unsigned)f.size());
+    uint8_t buf[32];
+    int n;
+    while ((n = f.read(buf, sizeof(buf))) > 0)
+    {
+      for (int i = 0; i < n; i++)
+        Serial.printf("%02x", buf[i]);
+      Serial.println();
+    }
+    f.close();
+    logln("END");
+    return;
+  }
+
+  for (uint8_t i = 0; i < REC_FILES; i++)
+  {
+    recPath(path, i);
+    if (!LittleFS.exists(path))
+      continue;
+    File f = LittleFS.open(path, "r");
+    Serial.printf("%u: %s %u bytes%s\n", i, path, (unsigned)f.size(), ((i + 1) % REC_FILES == recNext) ? " (latest)" : "");
+    f.close();
+  }
+  Serial.printf("dropped chunks: %u\n", recDropped);
+}
+
+void recorder_setup()
+{
+  // runs on the Boot task (boot.h) while loop() is already running - recOk goes true last
+  if (!LittleFS.begin(true)) // format on first use
+  {
+    logln("ERROR: LittleFS mount failed - match recording off");
+    return;
+  }
+
+  File idx = LittleFS.open("/recnext", "r");
+  if (idx)
+  {
+    int n = idx.read();
+    if (n >= 0)
+      recNext = n % REC_FILES;
+    idx.close();
+  }
+
+  recQueue = xQueueCreate(REC_QUEUE_LEN, sizeof(RecChunk));
+  task_create(recorderTask, "Recorder", TASK_RECORDER, &recTaskHandle);
+  console_add("rec", recorderCommand);
+  recOk = true;
+}
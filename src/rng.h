@@ -0,0 +1,137 @@
+/*
+  Random numbers for the effects, particles and sounds.
+
+  One small xorshift32 generator per user (a stream), so the particles don't change the
+  sparkle pattern and the sound detune doesn't change the particles. All of them start from
+  one seed: rng_seed() - the same seed gives the same explosion, sparkle and detune every time,
+  which is what the test scenes (framecap.h) and match replays rely on. The seed for each new
+  game is printed with "Reset Game Board", and "seed <n>" on the serial console makes the
+  next game use that seed.
+
+  No locks, no libc - a call is a few shifts. Pixel loops take one batch per frame with
+  rng_fill() rather than a call per pixel.
+*/
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+enum RngStream
+{
+  RNG_PARTICLES,
+  RNG_EFFECTS,      // startup sparkle, screensavers
+  RNG_SOUND,
+  RNG_STREAMS
+};
+
+static uint32_t rngState[RNG_STREAMS];
+static uint32_t rngSeedUsed = 0;
+
+// splitmix32 - spreads one seed into well mixed, never zero, stream states
+inline uint32_t rngMix(uint32_t x)
+{
+  x += 0x9E3779B9;
+  x = (x ^ (x >> 16)) * 0x85EBCA6B;
+  x = (x ^ (x >> 13)) * 0xC2B2AE35;
+  x ^= x >> 16;
+  return x ? x : 0x6D2B79F5;
+}
+
+void rng_seed(uint32_t seed)
+{
+  rngSeedUsed = seed;
+  for (int s = 0; s < RNG_STREAMS; s++)
+    rngState[s] = rngMix(seed + (uint32_t)s * 0x632BE5ABu);
+}
+
+inline uint32_t rng32(RngStream s)
+{
+  uint32_t x = rngState[s];
+  x ^= x << 13;
+  x ^= x >> 17;
+  x ^= x << 5;
+  rngState[s] = x;
+  return x;
+}
+
+// 0..255
+inline uint8_t rng8(RngStream s)
+{
+  return rng32(s) >> 24;
+}
+
+// 0..lim-1 - like FastLED's random8(lim)
+inline uint8_t rng8(RngStream s, uint8_t lim)
+{
+  return (rng8(s) * lim) >> 8;
+}
+
+// min..lim-1 - like FastLED's random8(min, lim)
+inline uint8_t rng8(RngStream s, uint8_t min, uint8_t lim)
+{
+  return min + rng8(s, lim - min);
+}
+
+// min..max-1 - like Arduino's random(min, max)
+inline int32_t rngRange(RngStream s, int32_t min, int32_t max)
+{
+  return min + (int32_t)(((uint64_t)rng32(s) * (uint32_t)(max - min)) >> 32);
+}
+
+/** rng_fill()
+ *  n random bytes into buf - four per step of the generator.
+ */
+void rng_fill(RngStream s, uint8_t* buf, size_t n)
+{
+  while (n >= 4)
+  {
+    uint32_t x = rng32(s);
+    buf[0] = x; buf[1] = x >> 8; buf[2] = x >> 16; buf[3] = x >> 24;
+    buf += 4;
+    n -= 4;
+  }
+  if (n)
+  {
+    uint32_t x = rng32(s);
+    while (n--)
+    {
+      *buf++ = x;
+      x >>= 8;
+    }
+  }
+}
+
+// scale a byte from rng_fill() to 0..lim-1 - the same as rng8(s, lim)
+inline uint8_t rngScale(uint8_t r, uint8_t lim)
+{
+  return (r * lim) >> 8;
+}
+
+#ifdef ARDUINO
+#include <Arduino.h>
+#include "settings.h"
+
+static uint32_t rngNextSeed = 0;   // from "seed <n>" - 0 = pick a new one
+
+/** rng_new_game()
+ *  A new game - seed every stream from "seed <n>" if one was given, otherwise a fresh random seed.
+ */
+void rng_new_game()
+{
+  rng_seed(rngNextSeed ? rngNextSeed : esp_random());
+  rngNextSeed = 0;
+}
+
+void rngCommand(char* arg1, char* arg2)
+{
+  if (arg1 && *arg1)
+    rngNextSeed = strtoul(arg1, NULL, 10);
+  Serial.printf("seed %u, next game %u\n", rngSeedUsed, rngNextSeed);
+}
+
+void rng_setup()
+{
+  rng_seed(esp_random());
+  console_add("seed", rngCommand);
+}
+#endif
@@ -0,0 +1,131 @@
+/*
+  Frame scheduler - wakes loop() once per frame instead of letting it spin on millis().
+
+  A periodic esp_timer fires every FRAME_INTERVAL_US (on an absolute schedule, so frames do
+  not drift) and gives a counting semaphore. loop() blocks on the semaphore, so core 1 is
+  free for other tasks - or idle - between frames.
+
+  If a frame takes longer than the interval the timer ticks pile up. Those late ticks are
+  thrown away (the game is time based, running frames back to back would not help) and
+  counted as overruns - "sched" on the serial console shows them. Gives from scheduler_now()
+  (power_wake()) are thrown away with them but are not overruns - they are counted apart.
+
+  A semaphore is used rather than a task notification because FastLEDshowESP32() already
+  uses the loop task's notification to wait for the show to finish.
+*/
+#pragma once
+
+#include <Arduino.h>
+#include <esp_timer.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include "config.h"
+#include "settings.h"
+
+static esp_timer_handle_t frameTimer = NULL;
+static SemaphoreHandle_t frameTick = NULL;
+static uint32_t framesRun = 0;
+static uint32_t frameOverruns = 0;     // frames dropped because the last one ran long
+static uint32_t frameWorstBusyUs = 0;  // longest frame (wake to next wait)
+static uint32_t frameWakeUs = 0;
+static uint64_t frameBusyTotalUs = 0;  // all the time loop() has spent in frames (power.h)
+static uint32_t frameForcedPending = 0; // scheduler_now() gives not yet taken - other tasks add them
+static uint32_t frameForced = 0;       // frames run early by scheduler_now()
+static portMUX_TYPE frameForcedLock = portMUX_INITIALIZER_UNLOCKED;
+
+void onFrameTimer(void* arg)
+{
+  xSemaphoreGive(frameTick);
+}
+
+/** scheduler_wait()
+ *  Call at the top of loop(). Sleeps until the next frame is due.
+ *  Returns false if no tick came (timer not running) - just return from loop() and try again.
+ */
+bool scheduler_wait()
+{
+  if (frameTick == NULL)
+  {
+    vTaskDelay(1);
+    return false;
+  }
+
+  if (frameWakeUs != 0)
+  {
+    uint32_t busy = micros() - frameWakeUs;
+    frameBusyTotalUs += busy;
+    if (busy > frameWorstBusyUs)
+      frameWorstBusyUs = busy;
+    frameWakeUs = 0; // counted - a timed out wait below must not count it again
+  }
+
+  if (xSemaphoreTake(frameTick, pdMS_TO_TICKS(100)) != pdTRUE)
+    return false;
+
+  // any more ticks waiting means we missed frames - unless scheduler_now() gave them
+  uint32_t extra = 0;
+  while (xSemaphoreTake(frameTick, 0) == pdTRUE)
+    extra++;
+  portENTER_CRITICAL(&frameForcedLock);
+  uint32_t forced = frameForcedPending;
+  frameForcedPending = 0;
+  portEXIT_CRITICAL(&frameForcedLock);
+  frameForced += forced;
+  if (extra > forced)
+    frameOverruns += extra - forced;
+
+  frameWakeUs = micros();
+  framesRun++;
+  return true;
+}
+
+void schedulerCommand(char* arg1, char* arg2)
+{
+  Serial.printf("frames: %u, overruns: %u, woken early: %u, longest frame: %u us (budget %u us)\n",
+                framesRun, frameOverruns, frameForced, frameWorstBusyUs, frameIntervalUs);
+  frameWorstBusyUs = 0;
+}
+
+/** scheduler_set_interval()
+ *  Change the frame rate - the next frame comes one new interval from now.
+ */
+void scheduler_set_interval(uint32_t us)
+{
+  if (frameTimer == NULL || us == frameIntervalUs)
+    return;
+  frameIntervalUs = us;
+  esp_timer_stop(frameTimer);
+  esp_timer_start_periodic(frameTimer, us);
+}
+
+/** scheduler_now()
+ *  Run the next frame straight away instead of at the next tick (e.g. something woke us up).
+ */
+void scheduler_now()
+{
+  if (frameTick == NULL)
+    return;
+  // counted before the give, so loop() never takes it as an overrun in between
+  portENTER_CRITICAL(&frameForcedLock);
+  frameForcedPending++;
+  portEXIT_CRITICAL(&frameForcedLock);
+  if (xSemaphoreGive(frameTick) != pdTRUE)
+  {// semaphore full - nothing was given
+    portENTER_CRITICAL(&frameForcedLock);
+    frameForcedPending--;
+    portEXIT_CRITICAL(&frameForcedLock);
+  }
+}
+
+void scheduler_setup()
+{
+  frameTick = xSemaphoreCreateCounting(8, 0);
+
+  esp_timer_create_args_t args = {};
+  args.callback = &onFrameTimer;
+  args.name = "frame";
+  esp_timer_create(&args, &frameTimer);
+  esp_timer_start_periodic(frameTimer, frameIntervalUs);
+
+  console_add("sched", schedulerCommand);
+}
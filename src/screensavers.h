@@ -3,8 +3,48 @@
 #include "Arduino.h"
 #include <FastLED.h>
 #include "config.h"
+#include "compositor.h"
+#include "rng.h"
+#include "fixmath.h"
+#include "tasks.h"
 
-extern CRGB leds[];
+extern CRGB* leds;   // the strip being drawn (arena.h)
+
+// The attract effects step once a frame, and were tuned at FRAME_RATE - but when nobody is
+// playing they run at IDLE_FRAME_RATE (power.h). So the per frame amounts (trail fade, hue
+// step, flash chance) are scaled by the frame interval, and look the same at either rate.
+// The beatsin dots are placed by time, so they move at the same speed - in bigger jumps.
+
+// fade that keeps 'keep'/256 of the trail each FRAME_RATE frame, for the current frame interval
+uint8_t effectFade(uint8_t keep)
+{
+  static uint8_t lastKeep = 0, scaled = 0;
+  static uint32_t lastInterval = 0;
+  if (keep != lastKeep || frameIntervalUs != lastInterval)
+  {// only when the rate changes - keep ^ (frames at FRAME_RATE per frame now)
+    lastKeep = keep;
+    lastInterval = frameIntervalUs;
+    scaled = (uint8_t)(powf(keep / 256.0f, (float)frameIntervalUs / FRAME_INTERVAL_US) * 256.0f);
+  }
+  return scaled;
+}
+
+// The time the effects see - millis(), or a fixed time while a test scene draws them
+// (renderTestScene() in ESP32TUG.ino, which makes it FastLED's GET_MILLIS for beatsin16).
+static unsigned long effectClockMs = 0;   // 0 = the real clock
+unsigned long effect_millis()
+{
+  return effectClockMs ? effectClockMs : millis();
+}
+
+static uint8_t effectHue = 0; // sinelon's rotating colour
+
+// how many FRAME_RATE frames this frame stands for (1 at full rate, 3 at 20 fps)
+inline uint8_t effectSteps()
+{
+  uint32_t n = (frameIntervalUs + FRAME_INTERVAL_US / 2) / FRAME_INTERVAL_US;
+  return n < 1 ? 1 : n;
+}
 
 // Fire2012 by Mark Kriegsman, July 2012
 // as part of "Five Elements" shown here: http://youtu.be/knWiGsmgycY
@@ -50,35 +90,38 @@ void Fire2012()
 {
   // Array of temperature readings at each simulation cell
   static byte heat[NUM_LEDS]; // the most possible
+  static uint8_t noise[NUM_LEDS];
   bool gReverseDirection = false;
 
   // Step 1.  Cool down every cell a little
-  for (int i = 0; i < NUM_LEDS; i++)
+  rng_fill(RNG_EFFECTS, noise, led_count);
+  uint8_t cooling = ((COOLING * 10) / led_count) + 2;
+  for (int i = 0; i < led_count; i++)
   {
-    heat[i] = qsub8(heat[i], random8(0, ((COOLING * 10) / NUM_LEDS) + 2));
+    heat[i] = qsub8(heat[i], rngScale(noise[i], cooling));
   }
 
   // Step 2.  Heat from each cell drifts 'up' and diffuses a little
-  for (int k = NUM_LEDS - 1; k >= 2; k--)
+  for (int k = led_count - 1; k >= 2; k--)
   {
     heat[k] = (heat[k - 1] + heat[k - 2] + heat[k - 2]) / 3;
   }
 
   // Step 3.  Randomly ignite new 'sparks' of heat near the bottom
-  if (random8() < SPARKING)
+  if (rng8(RNG_EFFECTS) < SPARKING)
   {
-    int y = random8(7);
-    heat[y] = qadd8(heat[y], random8(160, 255));
+    int y = rng8(RNG_EFFECTS, 7);
+    heat[y] = qadd8(heat[y], rng8(RNG_EFFECTS, 160, 255));
   }
 
   // Step 4.  Map from heat cells to LED colors
-  for (int j = 0; j < NUM_LEDS; j++)
+  for (int j = 0; j < led_count; j++)
   {
     CRGB color = HeatColor(heat[j]);
     int pixelnumber;
     if (gReverseDirection)
     {
-      pixelnumber = (NUM_LEDS - 1) - j;
+      pixelnumber = (led_count - 1) - j;
     }
     else
     {
@@ -92,66 +135,59 @@ void LED_march()
 {
   int n, b, c, i;
 
-  long millisNow = millis();
+  long millisNow = effect_millis();
 
-  for (i = 0; i < led_count; i++)
-  {
-    leds[i].nscale8(250);
-  }
+  compositor_fade(effectFade(250));
 
   // Marching green <> orange
   n = (millisNow / 250) % 10;
-  b = 10 + ((sin(millisNow / 500.00) + 1) * 20.00);
-  c = 20 + ((sin(millisNow / 5000.00) + 1) * 33);
+  b = 10 + ((((int32_t)sin15(phaseAt(millisNow, PHASE_STEP_RAD(500.0))) + 32768) * 40) >> 16);
+  c = 20 + ((((int32_t)sin15(phaseAt(millisNow, PHASE_STEP_RAD(5000.0))) + 32768) * 66) >> 16);
   for (i = 0; i < led_count; i++)
   {
     if (i % 10 == n)
     {
-      leds[i] = CHSV(c, 255, 150);
+      layerSet(LAYER_OVERLAY, i, CHSV(c, 255, 150));
     }
   }
 }
 
 void random_LED_flashes()
 {
-  long millisNow = millis();
+  static uint8_t noise[NUM_LEDS];
   int i;
 
-  for (i = 0; i < NUM_LEDS; i++)
-  {
-    leds[i].nscale8(250);
-  }
+  compositor_fade(effectFade(250));
 
-  randomSeed(millisNow);
-  for (i = 0; i < NUM_LEDS; i++)
+  rng_fill(RNG_EFFECTS, noise, led_count);
+  uint8_t odds = 20 / effectSteps(); // 1 in 20 a frame at full rate - as often a second at any rate
+  for (i = 0; i < led_count; i++)
   {
-    if (random8(20) == 0)
+    if (rngScale(noise[i], odds) == 0)
     {
-      leds[i] = CHSV(25, 255, 100);
+      layerSet(LAYER_OVERLAY, i, CHSV(25, 255, 100));
     }
   }
 }
 
 void sinelon()
 {
-  static uint8_t gHue = 0; // rotating "base color" used by many of the patterns
-
-  gHue++;
+  effectHue += effectSteps();
 
   // a colored dot sweeping back and forth, with fading trails
-  fadeToBlackBy(leds, NUM_LEDS, 20);
-  int pos = beatsin16(13, 0, NUM_LEDS);
-  leds[pos] += CHSV(gHue, 255, 192);
+  compositor_fade(effectFade(255 - 20));
+  int pos = beatsin16(13, 0, led_count - 1);
+  layerSet(LAYER_PARTICLES, pos, CHSV(effectHue, 255, 192));
 }
 
 void juggle()
 {
   // eight colored dots, weaving in and out of sync with each other
-  fadeToBlackBy(leds, NUM_LEDS, 20);
+  compositor_fade(effectFade(255 - 20));
   byte dothue = 0;
   for (int i = 0; i < 4; i++)
   {
-    leds[beatsin16(i + 7, 0, NUM_LEDS - 1)] |= CHSV(dothue, 200, 255);
+    layerSet(LAYER_EFFECTS, beatsin16(i + 7, 0, led_count - 1), CHSV(dothue, 200, 255));
     dothue += 64;
   }
 }
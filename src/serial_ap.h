@@ -3,6 +3,11 @@
 #include <Arduino.h>
 #include <freertos/FreeRTOS.h>
 #include <freertos/task.h>
+#include "tasks.h"
+#include "latency.h"
+#include "power.h"
+#include "history.h"
+#include "predictor.h"
 
 
 #define UART1_RX_PIN 16
@@ -12,9 +17,36 @@
 
 //brain parsers
 #include "Brain.h"
+#include "transport.h"
 extern Brain brainA;
 extern Brain brainB;
 
+// the wired headsets - each Brain reads from its own UART
+UartSource uartA(Serial1);
+UartSource uartB(Serial2);
+
+#ifdef TUG_BLUETOOTH
+// headset A over Bluetooth SPP instead of UART1 - the same parser, only the source changes
+BluetoothSerial btSerial;
+BluetoothSource btA(btSerial);
+static unsigned long btLastTry = 0;
+#endif
+
+#if TUG_ARENAS > 1
+// the second arena's headsets - UART0 is the console, so these two are software UARTs
+// (GPIO interrupts - plenty for 9600 baud and a packet a second)
+#include <SoftwareSerial.h>
+extern Brain brainC;
+extern Brain brainD;
+SoftwareSerial serialC;
+SoftwareSerial serialD;
+StreamSource uartC(serialC);
+StreamSource uartD(serialD);
+Brain* headsets[HEADSET_COUNT] = {&brainA, &brainB, &brainC, &brainD};
+#else
+Brain* headsets[HEADSET_COUNT] = {&brainA, &brainB};
+#endif
+
 #define MAX_BUFFER_SIZE 36 // Set for 36-byte packets
 
 // Task handle for the BLE task
@@ -23,6 +55,10 @@ static TaskHandle_t bt_loop_task_handle = NULL;
 // Client and characteristic objects for each device
 int bDebug = -1;
 
+// when the UART last said it had data for us - for the "jitter" console command
+static volatile uint32_t uartReadyUsA = 0;
+static volatile uint32_t uartReadyUsB = 0;
+
 void bt_loop();
 void DumpToLog(size_t length, uint8_t *pData);
 void DumpNewReadToLog();
@@ -32,31 +68,89 @@ void bt_setup() {
   // Initialize UART1 on specified pins, 9600, 8N1
   Serial1.begin(9600, SERIAL_8N1, UART1_RX_PIN, UART1_TX_PIN);
   Serial2.begin(9600, SERIAL_8N1, UART2_RX_PIN, UART2_TX_PIN);
-  // small pause so driver settles
-  vTaskDelay(pdMS_TO_TICKS(50));
+  // stamp when bytes are ready, and wake the SerialAB task if it is sleeping (idle - see power.h)
+  Serial1.onReceive([]() { if (uartReadyUsA == 0) uartReadyUsA = micros(); if (bt_loop_task_handle) xTaskNotifyGive(bt_loop_task_handle); });
+  Serial2.onReceive([]() { if (uartReadyUsB == 0) uartReadyUsB = micros(); if (bt_loop_task_handle) xTaskNotifyGive(bt_loop_task_handle); });
+#ifdef TUG_BLUETOOTH
+  brainA.setSource(&btA);  // connected from the SerialAB task (bt_connect())
+#else
+  brainA.setSource(&uartA);
+#endif
+  brainB.setSource(&uartB);
+#if TUG_ARENAS > 1
+  serialC.begin(9600, SWSERIAL_8N1, HEADSET_C_RX_PIN, -1, false, 256); // 256 byte buffer - see POWER_IDLE_POLL_MS
+  serialD.begin(9600, SWSERIAL_8N1, HEADSET_D_RX_PIN, -1, false, 256);
+  brainC.setSource(&uartC);
+  brainD.setSource(&uartD);
+#endif
+  // only the hardware UARTs' pins wake us - the software UARTs' pins already have their own
+  // (CHANGE) interrupt, and a wakeup level on them would turn every low bit into an interrupt
+  const int rxPins[] = {UART1_RX_PIN, UART2_RX_PIN};
+  power_setup(rxPins, 2);
+
+  // Create the BLE task / polling task - core, priority and stack are in tasks.h
+  task_create(bt_loop_task, "SerialAB", TASK_SERIAL, &bt_loop_task_handle);
+}
 
-  // Create the BLE task / polling task (keeps existing behaviour)
-  xTaskCreatePinnedToCore(
-    bt_loop_task,          // Task function
-    "SerialAB",             // Task name
-    2048,                  // Stack size (4KB)
-    NULL,                  // Task parameters
-    2,                     // Priority
-    &bt_loop_task_handle,  // Task handle
-    1                      // Core 1
-  );
+#ifdef TUG_BLUETOOTH
+// SerialAB task - (re)connect headset A's HC-05. connect() blocks for a few seconds while it
+// searches, and headset B's bytes wait in the UART buffer meanwhile.
+void bt_connect() {
+  if (btA.connected() || (btLastTry != 0 && millis() - btLastTry < BT_RETRY_MS))
+    return;
+  btLastTry = millis();
+  Serial.printf("Bluetooth: connecting to %s\n", BT_HEADSET_NAME);
+  if (btA.connect(BT_HEADSET_NAME, BT_HEADSET_PIN))
+    logln("Bluetooth: headset A connected");
 }
+#endif
 
 void bt_loop() {
   // Read all bytes available on UART1 and forward in one chunk to dataArrived_A
   boolean gotNewData = false;
-  while (Serial1.available() > 0) {
-    uint8_t c = (uint8_t)Serial1.read();
-    gotNewData |= brainA.update(c);
+  uint32_t readyA = uartReadyUsA;
+  uint32_t readyB = uartReadyUsB;
+  if (readyA != 0 && Serial1.available() > 0) {
+    jitter_uart(readyA);
+    uartReadyUsA = 0;
+  }
+  if (readyB != 0 && Serial2.available() > 0) {
+    jitter_uart(readyB);
+    uartReadyUsB = 0;
+  }
+  // the ready stamps say when the bytes arrived - for the latency trace
+  // polling only frames and checks the packets - loop() takes them from the queues (bt_dispatch())
+  gotNewData |= brainA.poll(readyA);
+  gotNewData |= brainB.poll(readyB);
+  for (int h = 2; h < HEADSET_COUNT; h++) {
+    // the second arena's - no ready stamps from a software UART
+    gotNewData |= headsets[h]->poll();
+  }
+  if (gotNewData) {
+    power_wake(); // idle? - back to full rate now, not at the next slow frame
   }
-  while (Serial2.available() > 0) {
-    uint8_t c = (uint8_t)Serial2.read();
-    gotNewData |= brainB.update(c);
+  // allow other tasks to run
+  vTaskDelay(pdMS_TO_TICKS(1));
+}
+
+/** bt_dispatch()
+ *  loop(), once per frame - every packet the parser queued since the last frame, in one batch:
+ *  into the game (Brain::consume()), then to the latency trace, the history and the predictor.
+ *  The log line is printed once a batch.
+ */
+void bt_dispatch(unsigned long millisNow) {
+  boolean gotNewData = false;
+  BrainPacket packet;
+  for (int h = 0; h < HEADSET_COUNT; h++) {
+    Brain& brain = *headsets[h];
+    while (brain.nextPacket(packet)) {
+      brain.consume(packet);
+      if (h < 2)
+        latency_packet(h, brain); // the latency trace follows the first arena
+      history_packet(h, brain);
+      predict_packet(h, brain, millisNow);
+      gotNewData = true;
+    }
   }
   if (gotNewData) {
     //Serial.print("Data! ");
@@ -64,16 +158,21 @@ void bt_loop() {
     DumpNewReadToLog();
     //DumpToLog(
   }
-  // allow other tasks to run
-  vTaskDelay(pdMS_TO_TICKS(1));
 }
 
 void bt_loop_task(void *pvParameters) {
+  // small pause so the UART drivers settle - here rather than in bt_setup() so boot carries on
+  vTaskDelay(pdMS_TO_TICKS(50));
   // Run loop forever
   for (;;) {
+#ifdef TUG_BLUETOOTH
+    bt_connect();
+#endif
     bt_loop();
-    // Small delay to ensure task yields
-    vTaskDelay(pdMS_TO_TICKS(1));
+    if (power_idle())
+      ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(POWER_IDLE_POLL_MS)); // idle - sleep until a UART has bytes
+    else
+      vTaskDelay(pdMS_TO_TICKS(1)); // Small delay to ensure task yields
   }
 }
 
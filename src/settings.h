@@ -0,0 +1,310 @@
+/*
+  Runtime settings - saved in NVS flash and tuned live over the serial console.
+
+  Each setting is one row in the settings table below (name, type, limits, default).
+  The defaults come from config.h - a blank or erased board boots with those.
+
+  Serial console (115200, one command per line):
+    list                 - show all settings
+    get <name>           - show one setting
+    set <name> <value>   - change a setting (applied at the start of the next frame)
+    save                 - write the settings to flash now
+    reset                - put all settings back to the config.h defaults
+  Other modules can add their own commands with console_add().
+
+  Changes made with "set" are saved automatically a few seconds after the last change.
+  The flash write is done from a low priority task on core 0 - never from the render loop -
+  and the sound timer is paused around it (flash writes stall interrupts running from flash).
+*/
+#pragma once
+
+#include <Arduino.h>
+#include <Preferences.h>
+#include <FastLED.h>
+#include "config.h"
+#include "pixels.h"
+#include "sound.h"
+#include "tasks.h"
+
+#define SETTINGS_NAMESPACE "tug32"
+#define SETTINGS_SAVE_DELAY 3000  // ms after the last change before writing to flash
+#define SETTINGS_LINE_LEN 48
+#define CONSOLE_MAX_COMMANDS 16
+
+void arena_blank_unused(uint16_t from);
+
+// The live values - read by the game, Brain.cpp and the effects
+uint8_t averagingLength = DEFAULT_AVERAGING_LENGTH;
+uint8_t led_brightness = DEFAULT_LED_BRIGHTNESS;
+uint8_t audio_volume = DEFAULT_AUDIO_VOLUME;
+uint8_t qualityGate = DEFAULT_QUALITY_GATE;
+uint16_t screensaverTimeout = DEFAULT_SCREENSAVER_TIMEOUT;
+uint16_t calibrateTimeout = DEFAULT_CALIBRATE_TIMEOUT;
+uint16_t led_count = NUM_LEDS;
+uint8_t telemetryHz = DEFAULT_TELEMETRY_HZ;
+uint8_t predictInput = DEFAULT_PREDICT;
+
+enum SettingType { SET_U8, SET_U16 };
+
+struct Setting
+{
+  const char* name;     // console name and NVS key (max 15 chars)
+  SettingType type;
+  void* value;          // the live value
+  uint16_t minValue;
+  uint16_t maxValue;
+  uint16_t defaultValue;
+  uint16_t pending;     // value set on the console - copied to the live value at a frame boundary
+};
+
+Setting settingsTable[] = {
+  {"brightness",  SET_U8,  &led_brightness,     1,   255,   DEFAULT_LED_BRIGHTNESS},
+  {"volume",      SET_U8,  &audio_volume,       0,   255,   DEFAULT_AUDIO_VOLUME},
+  {"leds",        SET_U16, &led_count,          MIN_LEDS, NUM_LEDS, NUM_LEDS},
+  {"averaging",   SET_U8,  &averagingLength,    1,   MAX_AVERAGING_LENGTH, DEFAULT_AVERAGING_LENGTH},
+  {"quality",     SET_U8,  &qualityGate,        1,   200,   DEFAULT_QUALITY_GATE},
+  {"predict",     SET_U8,  &predictInput,       0,   1,     DEFAULT_PREDICT},
+  {"saver_ms",    SET_U16, &screensaverTimeout, 500, 60000, DEFAULT_SCREENSAVER_TIMEOUT},
+  {"calib_ms",    SET_U16, &calibrateTimeout,   500, 10000, DEFAULT_CALIBRATE_TIMEOUT},
+  {"layout",      SET_U8,  &taskLayout,         0,   TASK_LAYOUTS - 1, DEFAULT_TASK_LAYOUT}, // used at next boot
+  {"telem_hz",    SET_U8,  &telemetryHz,        0,   30,    DEFAULT_TELEMETRY_HZ},    // used at next boot
+};
+#define SETTINGS_COUNT (int)(sizeof(settingsTable) / sizeof(settingsTable[0]))
+
+static Preferences settingsPrefs;
+static TaskHandle_t settingsSaveTaskHandle = NULL;
+static volatile bool settingsChanged = false; // pending values waiting for a frame boundary
+static bool settingsDirty = false;            // live values not yet written to flash
+static bool settingsSaveNow = false;          // "save" typed on the console
+static unsigned long settingsLastChange = 0;
+static char settingsLine[SETTINGS_LINE_LEN];
+static uint8_t settingsLineLen = 0;
+
+// extra console commands added by other modules
+typedef void (*ConsoleCommand)(char* arg1, char* arg2);
+struct ConsoleEntry
+{
+  const char* name;
+  ConsoleCommand fn;
+};
+static ConsoleEntry consoleCommands[CONSOLE_MAX_COMMANDS];
+static uint8_t consoleCommandCount = 0;
+
+static portMUX_TYPE consoleLock = portMUX_INITIALIZER_UNLOCKED;
+
+// add a command to the serial console - call from setup() (or the Boot task - see boot.h)
+void console_add(const char* name, ConsoleCommand fn)
+{
+  bool added = false;
+  portENTER_CRITICAL(&consoleLock);
+  if (consoleCommandCount < CONSOLE_MAX_COMMANDS)
+  {
+    consoleCommands[consoleCommandCount] = {name, fn};
+    consoleCommandCount++; // after the entry - the console may be reading on the other core
+    added = true;
+  }
+  portEXIT_CRITICAL(&consoleLock);
+  if (!added)
+    logln("ERROR: too many console commands");
+}
+
+uint16_t settingGet(const Setting& s)
+{
+  if (s.type == SET_U8)
+    return *(uint8_t*)s.value;
+  return *(uint16_t*)s.value;
+}
+
+void settingPut(Setting& s, uint16_t v)
+{
+  if (s.type == SET_U8)
+    *(uint8_t*)s.value = (uint8_t)v;
+  else
+    *(uint16_t*)s.value = v;
+}
+
+Setting* settingFind(const char* name)
+{
+  for (int i = 0; i < SETTINGS_COUNT; i++)
+  {
+    if (strcmp(settingsTable[i].name, name) == 0)
+      return &settingsTable[i];
+  }
+  return NULL;
+}
+
+void settingsSave()
+{
+  sound_pause(); // flash write disables the cache - keep the sound interrupt out of the way
+  settingsPrefs.begin(SETTINGS_NAMESPACE, false);
+  for (int i = 0; i < SETTINGS_COUNT; i++)
+  {
+    uint16_t v = settingGet(settingsTable[i]);
+    if (settingsPrefs.getUShort(settingsTable[i].name, settingsTable[i].defaultValue) != v)
+      settingsPrefs.putUShort(settingsTable[i].name, v); // only write what changed - saves flash wear
+  }
+  settingsPrefs.end();
+  sound_resume();
+  logln("Settings saved");
+}
+
+/** settingsSaveTask
+ *  Low priority task on core 0 - waits to be told to write the settings to flash.
+ */
+void settingsSaveTask(void *pvParameters)
+{
+  for (;;)
+  {
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    settingsSave();
+  }
+}
+
+// copy the live values to the pending values so the console shows and edits the right thing
+void settingsSyncPending()
+{
+  for (int i = 0; i < SETTINGS_COUNT; i++)
+    settingsTable[i].pending = settingGet(settingsTable[i]);
+}
+
+void settings_setup()
+{
+  settingsPrefs.begin(SETTINGS_NAMESPACE, true);
+  for (int i = 0; i < SETTINGS_COUNT; i++)
+  {
+    Setting& s = settingsTable[i];
+    uint16_t v = settingsPrefs.getUShort(s.name, s.defaultValue);
+    settingPut(s, constrain(v, s.minValue, s.maxValue));
+  }
+  settingsPrefs.end();
+  settingsSyncPending();
+
+  task_create(settingsSaveTask, "SettingsSave", TASK_SETTINGS, &settingsSaveTaskHandle);
+}
+
+void settingsPrint(const Setting& s)
+{
+  Serial.printf("%s = %u  (%u..%u, default %u)\n", s.name, s.pending, s.minValue, s.maxValue, s.defaultValue);
+}
+
+void settingsCommand(char* line)
+{
+  char* cmd = strtok(line, " \t");
+  char* name = strtok(NULL, " \t");
+  char* value = strtok(NULL, " \t");
+  if (cmd == NULL)
+    return;
+
+  if (strcmp(cmd, "list") == 0)
+  {
+    for (int i = 0; i < SETTINGS_COUNT; i++)
+      settingsPrint(settingsTable[i]);
+  }
+  else if (strcmp(cmd, "get") == 0 || strcmp(cmd, "set") == 0)
+  {
+    Setting* s = name ? settingFind(name) : NULL;
+    if (s == NULL)
+    {
+      logln("ERROR: unknown setting - type list");
+      return;
+    }
+    if (cmd[0] == 's')
+    {
+      if (value == NULL)
+      {
+        logln("ERROR: set <name> <value>");
+        return;
+      }
+      long v = atol(value);
+      if (v < s->minValue || v > s->maxValue)
+      {
+        Serial.printf("ERROR: %s must be %u..%u\n", s->name, s->minValue, s->maxValue);
+        return;
+      }
+      s->pending = (uint16_t)v;
+      settingsChanged = true;
+    }
+    settingsPrint(*s);
+  }
+  else if (strcmp(cmd, "save") == 0)
+  {
+    settingsSaveNow = true; // written after any pending changes are applied
+  }
+  else if (strcmp(cmd, "reset") == 0)
+  {
+    for (int i = 0; i < SETTINGS_COUNT; i++)
+      settingsTable[i].pending = settingsTable[i].defaultValue;
+    settingsChanged = true;
+    logln("Settings reset to defaults");
+  }
+  else
+  {
+    for (int i = 0; i < consoleCommandCount; i++)
+    {
+      if (strcmp(cmd, consoleCommands[i].name) == 0)
+      {
+        consoleCommands[i].fn(name, value);
+        return;
+      }
+    }
+    log("commands: list, get <name>, set <name> <value>, save, reset");
+    for (int i = 0; i < consoleCommandCount; i++)
+    {
+      log(", ");
+      log(consoleCommands[i].name);
+    }
+    logln();
+  }
+}
+
+// apply pending changes - call at the start of a frame so a frame never sees half a change
+void settingsApply(unsigned long millisNow)
+{
+  if (!settingsChanged)
+    return;
+  settingsChanged = false;
+
+  uint16_t oldLedCount = led_count;
+  for (int i = 0; i < SETTINGS_COUNT; i++)
+    settingPut(settingsTable[i], settingsTable[i].pending);
+
+  pixels_set_brightness(led_brightness);
+  if (led_count < oldLedCount)
+    arena_blank_unused(led_count); // switch off the pixels no longer used
+  // averagingLength is picked up by the brains at their next packet
+
+  settingsDirty = true;
+  settingsLastChange = millisNow;
+}
+
+/** settings_tick()
+ *  Call once per frame from loop(). Reads the console, applies pending changes
+ *  and kicks off the deferred flash write once things have been quiet for a while.
+ */
+void settings_tick(unsigned long millisNow)
+{
+  while (Serial.available() > 0)
+  {
+    char c = (char)Serial.read();
+    if (c == '\r' || c == '\n')
+    {
+      if (settingsLineLen > 0)
+      {
+        settingsLine[settingsLineLen] = 0;
+        settingsLineLen = 0;
+        settingsCommand(settingsLine);
+      }
+    }
+    else if (settingsLineLen < SETTINGS_LINE_LEN - 1)
+      settingsLine[settingsLineLen++] = c;
+  }
+
+  settingsApply(millisNow);
+
+  if (settingsSaveNow || (settingsDirty && millisNow - settingsLastChange > SETTINGS_SAVE_DELAY))
+  {
+    settingsSaveNow = false;
+    settingsDirty = false;
+    xTaskNotifyGive(settingsSaveTaskHandle);
+  }
+}
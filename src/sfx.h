@@ -4,10 +4,11 @@
 #include "Arduino.h"
 #include "config.h"
 #include "sound.h"
+#include "rng.h"
+#include "fixmath.h"
 
 
-extern unsigned long timeOfStageStart;    // Stores the time the stage changed for stages that are time based
-extern int puckPosition;         // Stores the puck position (0..NUM_LEDS-1)
+#include "arena.h"   // the stage timer of the arena being ticked
 
 // ---------------------------------
 // -------------- SFX --------------
@@ -53,7 +54,7 @@ void SFXFreqSweepWarble(int duration, int elapsedTime, int freqStart, int freqEn
 {
   int freq = map_constrain(elapsedTime, 0, duration, freqStart, freqEnd);
   if (warble)
-    warble = map(sin(millis() / 20.0) * 1000.0, -1000, 1000, 0, warble);
+    warble = (warble * ((int32_t)sin15(phaseAt(millis(), PHASE_STEP_RAD(20.0))) + 32768)) >> 16;
 
   sound(freq + warble, audio_volume);
 }
@@ -82,7 +83,7 @@ void SFXFreqSweepNoise(int duration, int elapsedTime, int freqStart, int freqEnd
     freq = map(elapsedTime, 0, duration, freqStart, freqEnd);
 
   if (noiseFactor)
-    noiseFactor = noiseFactor - random8(noiseFactor / 2);
+    noiseFactor = noiseFactor - rng8(RNG_SOUND, noiseFactor / 2);
 
   sound(freq + noiseFactor, audio_volume);
 }
@@ -94,7 +95,7 @@ static inline float midiToFreq(int midiNote) {
 
 void SFXPuckPosition(int amount)
 {//values are between 0 and Num_Leds-1
-  #define MAX_AMOUNT NUM_LEDS
+  #define MAX_AMOUNT led_count
   // normalize to 0..100 (guard against larger ranges)
   int val = constrain(abs(amount), 0, MAX_AMOUNT);
 
@@ -114,7 +115,7 @@ void SFXPuckPosition(int amount)
   int freq = (int)round(midiToFreq(midi));
 
   // small tasteful variation (a little detune, not large random noise)
-  freq += random(-6, 7); // +/- ~6 Hz variation
+  freq += rngRange(RNG_SOUND, -6, 7); // +/- ~6 Hz variation
 
   // volume mapping: gentle scale from quieter to configured volume
   int vol = map(val, 0, MAX_AMOUNT, audio_volume / 3, audio_volume);
@@ -162,7 +163,8 @@ void SFXAttention(int amountA, int amountB)
     return;
   }
 
-  int f = map(abs(amount), -100, +100, 80, 900) + random8(100);
+  static constexpr FixMap attentionFreq(-100, +100, 80, 900);
+  int f = attentionFreq(abs(amount)) + rng8(RNG_SOUND, 100);
   int vol = map(abs(amount), -100, +100, audio_volume / 2, audio_volume * 3 / 4);
   sound(f, vol);
 }
@@ -172,8 +174,8 @@ void SFXAttention(int amountA, int amountB)
 
 void SFXattacking()
 {
-  int freq = map(sin(millis() / 2.0) * 1000.0, -1000, 1000, 500, 600);
-  if (random8(5) == 0)
+  int freq = 500 + ((((int32_t)sin15(phaseAt(millis(), PHASE_STEP_RAD(2.0))) + 32768) * 100) >> 16);
+  if (rng8(RNG_SOUND, 5) == 0)
   {
     freq *= 3;
   }
@@ -182,7 +184,7 @@ void SFXattacking()
 
 void SFXdead()
 {//plays next part of sound - since we are dead(that time is held in timeOfStageStart)
-  SFXFreqSweepNoise(1000, millis() - timeOfStageStart, 1000, 10, 200);
+  SFXFreqSweepNoise(1000, millis() - arena->timeOfStageStart, 1000, 10, 200);
 }
 
 
@@ -203,5 +205,5 @@ void SFXbosskilled()
 
 /*void SFXgameover()
 {
-  SFXFreqSweepWarble(GAMEOVER_SPREAD_DURATION, millis() - timeOfStageStart, 440, 20, 60);
+  SFXFreqSweepWarble(GAMEOVER_SPREAD_DURATION, millis() - arena->timeOfStageStart, 440, 20, 60);
 }*/
@@ -10,6 +10,7 @@
 #pragma once
 
 #include "esp32-hal-timer.h"
+#include "soc/rtc_io_reg.h"
 
 #define ESP32_F_CPU         80000000  // the speed of the processor
 #define AUDIO_INTERRUPT_PRESCALER   80 
@@ -23,6 +24,7 @@ hw_timer_t * sndTimer = NULL;
 bool sound_on = true;
 bool sound_wave_high = true;  // this toggles to create the high/low transitions of the wave
 uint8_t sound_volume = 0;
+bool sound_muted = false;     // a second arena - the speaker follows the first (arena.h)
 
 void sound_init(int pin);
 bool sound(uint16_t freq, uint8_t volume);
@@ -32,21 +34,32 @@ int dac_pin;
 
 
 
+// set the DAC level straight in its register - dacWrite() runs from flash, so the interrupt
+// would stall on a cache miss (or while flash is being written). sound_init() powers the DAC up.
+static inline void IRAM_ATTR dacWriteFast(uint8_t value)
+{
+  if (dac_pin == 25)
+    SET_PERI_REG_BITS(RTC_IO_PAD_DAC1_REG, RTC_IO_PDAC1_DAC, value, RTC_IO_PDAC1_DAC_S);
+  else
+    SET_PERI_REG_BITS(RTC_IO_PAD_DAC2_REG, RTC_IO_PDAC2_DAC, value, RTC_IO_PDAC2_DAC_S);
+}
+
 void IRAM_ATTR onSoundTimer() 
 {    
   if (sound_on) {    
-			dacWrite(dac_pin, (sound_wave_high?sound_volume:0));
+			dacWriteFast(sound_wave_high?sound_volume:0);
       sound_wave_high = ! sound_wave_high;
    
   }
   else
-    dacWrite(dac_pin, 0);
+    dacWriteFast(0);
 }
 
 void sound_init(int pin){  // pin must be a DAC pin number !! (typically 25 or 26)
   dac_pin = pin;
 	sound_on = false;
 	pinMode(dac_pin, OUTPUT);
+	dacWrite(dac_pin, 0); // powers up the DAC - from now on the interrupt just sets the level
 	sound_volume = 0;
 	
 	sndTimer = timerBegin(SOUND_TIMER_NO, AUDIO_INTERRUPT_PRESCALER, true);
@@ -67,7 +80,13 @@ void sound_resume() // resume from pause ... after eeprom write
 		timerRestart(sndTimer);
 }
 
+void sound_mute(bool muted){
+	sound_muted = muted;
+}
+
 bool sound(uint16_t freq, uint8_t volume){
+	if (sound_muted)
+		return false;
 	if (volume == 0) {
 		soundOff();
 		return false;
@@ -82,6 +101,8 @@ bool sound(uint16_t freq, uint8_t volume){
 }
 
 void soundOff(){  
+ if (sound_muted)
+   return;
  sound_on = false;
  sound_volume = 0;
  timerAlarmWrite(sndTimer, ESP32_F_CPU/AUDIO_INTERRUPT_PRESCALER/(MIN_FREQ), true);  // lower timer freq
@@ -0,0 +1,123 @@
+/*
+  Task layout - which core, priority and stack each of our FreeRTOS tasks gets.
+
+  All tasks are created through task_create() from one table, so a layout can be tried
+  without hunting through the code. The layout is a setting ("set layout <n>", then "save"
+  and reset the board - tasks are only placed at boot).
+
+  The Arduino loop() (the renderer) always runs on core 1 at priority 1.
+
+  Layouts:
+    0 original - headset parsing on core 1 with the renderer, FastLED.show() on core 0 (default)
+    1 split    - headset parsing on core 0 above the show task, core 1 only renders
+    2 render-1 - FastLED.show() on core 1 (loop() is idle while it waits anyway), core 0 only parses
+
+  "jitter" on the serial console prints how long headset bytes wait before they are parsed
+  and how far frame starts drift from the frame interval - compare layouts with it.
+  "tasks" shows how much stack each task has left (see diag.h) - size the stacks from that.
+  Layout 0 stays the default until "jitter" has been compared across the layouts on a board
+  in a game - the default should be the one that measured best. Layout 1 is the one to try
+  first: the parser would no longer preempt the renderer and still run ahead of the show
+  task, which spends most of its time blocked on the RMT driver.
+*/
+#pragma once
+
+#include <Arduino.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include "config.h"
+
+#define TASK_LAYOUTS 3
+#define DEFAULT_TASK_LAYOUT 0
+
+enum TaskId
+{
+  TASK_SHOW,      // FastLEDshowTask
+  TASK_SERIAL,    // SerialAB - headset parsing
+  TASK_SETTINGS,  // settings flash writes
+  TASK_RECORDER,  // match recorder flash writes
+  TASK_DIAG,      // task CPU/stack monitor
+  TASK_BOOT,      // slow init at power on - deletes itself (boot.h)
+  TASK_COUNT
+};
+
+struct TaskPlacement
+{
+  uint8_t core;
+  uint8_t priority;
+  uint16_t stack;   // bytes
+};
+
+const char* taskLayoutNames[TASK_LAYOUTS] = {"original", "split", "render-1"};
+
+const TaskPlacement taskLayouts[TASK_LAYOUTS][TASK_COUNT] = {
+  //  show          serial        settings      recorder      diag          boot
+  { {0, 2, 2048}, {1, 2, 2048}, {0, 1, 3072}, {0, 1, 3072}, {0, 1, 3072}, {0, 1, 4096} },  // 0 original
+  { {0, 2, 2048}, {0, 3, 2048}, {0, 1, 3072}, {0, 1, 3072}, {0, 1, 3072}, {0, 1, 4096} },  // 1 split
+  { {1, 2, 2048}, {0, 3, 2048}, {0, 1, 3072}, {0, 1, 3072}, {0, 1, 3072}, {0, 1, 4096} },  // 2 render-1
+};
+
+uint8_t taskLayout = DEFAULT_TASK_LAYOUT; // a setting - see settings.h
+
+BaseType_t task_create(TaskFunction_t fn, const char* name, TaskId id, TaskHandle_t* handle)
+{
+  const TaskPlacement& p = taskLayouts[taskLayout % TASK_LAYOUTS][id];
+  return xTaskCreatePinnedToCore(fn, name, p.stack, NULL, p.priority, handle, p.core);
+}
+
+// -------- jitter measurement ---------
+struct JitterStats
+{
+  uint32_t count;
+  uint32_t maxUs;
+  uint64_t totalUs;
+};
+
+static JitterStats uartJitter;    // UART data ready -> parser reads it
+static JitterStats frameJitter;   // frame start -> when it should have started
+static uint32_t lastFrameStartUs = 0;
+static uint32_t frameIntervalUs = FRAME_INTERVAL_US;   // lower frame rate when idle (power.h)
+
+inline void jitterAdd(JitterStats& j, uint32_t us)
+{
+  j.count++;
+  j.totalUs += us;
+  if (us > j.maxUs)
+    j.maxUs = us;
+}
+
+/** jitter_frame()
+ *  Call at the start of every frame.
+ */
+void jitter_frame()
+{
+  uint32_t now = micros();
+  if (lastFrameStartUs != 0)
+  {
+    int32_t late = (int32_t)(now - lastFrameStartUs) - (int32_t)frameIntervalUs;
+    jitterAdd(frameJitter, late > 0 ? late : -late);
+  }
+  lastFrameStartUs = now;
+}
+
+/** jitter_uart()
+ *  Call from the parser with the time (micros) the UART reported data ready.
+ */
+void jitter_uart(uint32_t readyUs)
+{
+  jitterAdd(uartJitter, micros() - readyUs);
+}
+
+void jitterPrint(const char* name, JitterStats& j)
+{
+  Serial.printf("%s: %u samples, mean %u us, max %u us\n", name, j.count,
+                j.count ? (uint32_t)(j.totalUs / j.count) : 0, j.maxUs);
+  memset(&j, 0, sizeof(j));
+}
+
+void jitterCommand(char* arg1, char* arg2)
+{
+  Serial.printf("layout %u (%s)\n", taskLayout, taskLayoutNames[taskLayout % TASK_LAYOUTS]);
+  jitterPrint("uart->parse", uartJitter);
+  jitterPrint("frame start", frameJitter);
+}
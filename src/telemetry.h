@@ -0,0 +1,131 @@
+/*
+  UDP telemetry - streams the game state over WiFi for spectator dashboards.
+
+  Off unless the "telem_hz" setting is above 0 (it is read at boot - set it, save, reset).
+  The board joins the WiFi network in config.h and broadcasts datagrams to TELEMETRY_PORT,
+  so nothing on the network needs to be configured with the board's address.
+
+  Samples are taken at telem_hz and sent TELEMETRY_BATCH to a datagram, so even at 30 Hz
+  only a few packets a second go out. The datagram is built in place in one static buffer.
+
+  Datagram (little endian):
+    header   'T','G', version, sample count, sequence number (u16)
+    sample   millis (u32), stage (u8), puckPosition (u16), then for player A and player B:
+               attention, average, signal quality, raw signal quality (u8 each),
+               eight EEG band powers (24 bit each)
+  tools/telemetry_rx receives them and prints CSV and live stats.
+*/
+#pragma once
+
+#include <Arduino.h>
+#include <WiFi.h>
+#include <WiFiUdp.h>
+#include "config.h"
+#include "Brain.h"
+#include "settings.h"
+
+#define TELEMETRY_VERSION 1
+#define TELEMETRY_BATCH 4
+#define TELEMETRY_HEADER 6
+#define TELEMETRY_PLAYER_BYTES (4 + EEG_POWER_BANDS * 3)
+#define TELEMETRY_SAMPLE_BYTES (4 + 1 + 2 + 2 * TELEMETRY_PLAYER_BYTES)
+
+static WiFiUDP telemetryUdp;
+static bool telemetryOn = false;
+static uint8_t telemetryBuf[TELEMETRY_HEADER + TELEMETRY_BATCH * TELEMETRY_SAMPLE_BYTES];
+static uint8_t telemetryCount = 0;
+static uint16_t telemetrySeq = 0;
+static unsigned long telemetryLast = 0;
+static uint8_t telemetryRateHz = 0;   // telem_hz at boot - the setting can change live, the rate can't
+static uint32_t telemetrySent = 0;
+
+inline uint8_t* telemetryPut16(uint8_t* p, uint16_t v)
+{
+  p[0] = v; p[1] = v >> 8;
+  return p + 2;
+}
+
+inline uint8_t* telemetryPut32(uint8_t* p, uint32_t v)
+{
+  p[0] = v; p[1] = v >> 8; p[2] = v >> 16; p[3] = v >> 24;
+  return p + 4;
+}
+
+uint8_t* telemetryPutPlayer(uint8_t* p, Brain& b)
+{
+  *p++ = b.attention;
+  *p++ = b.getAverage();
+  *p++ = b.signalQuality;
+  *p++ = b.signalQualityNotEstimated;
+  uint32_t* power = b.readPowerArray();
+  for (int i = 0; i < EEG_POWER_BANDS; i++)
+  {
+    *p++ = power[i];
+    *p++ = power[i] >> 8;
+    *p++ = power[i] >> 16;
+  }
+  return p;
+}
+
+void telemetrySend()
+{
+  uint8_t* p = telemetryBuf;
+  *p++ = 'T';
+  *p++ = 'G';
+  *p++ = TELEMETRY_VERSION;
+  *p++ = telemetryCount;
+  telemetryPut16(p, telemetrySeq++);
+
+  telemetryUdp.beginPacket(IPAddress(255, 255, 255, 255), TELEMETRY_PORT);
+  telemetryUdp.write(telemetryBuf, TELEMETRY_HEADER + telemetryCount * TELEMETRY_SAMPLE_BYTES);
+  telemetryUdp.endPacket();
+  telemetryCount = 0;
+  telemetrySent++;
+}
+
+/** telemetry_tick()
+ *  Call once per frame. Takes a sample when one is due and sends a full batch.
+ */
+void telemetry_tick(unsigned long millisNow, uint8_t stage, int puck, Brain& a, Brain& b)
+{
+  if (!telemetryOn || WiFi.status() != WL_CONNECTED)
+    return;
+  if (millisNow - telemetryLast < 1000UL / telemetryRateHz)
+    return;
+  telemetryLast = millisNow;
+
+  uint8_t* p = telemetryBuf + TELEMETRY_HEADER + telemetryCount * TELEMETRY_SAMPLE_BYTES;
+  p = telemetryPut32(p, millisNow);
+  *p++ = stage;
+  p = telemetryPut16(p, puck);
+  p = telemetryPutPlayer(p, a);
+  telemetryPutPlayer(p, b);
+
+  if (++telemetryCount == TELEMETRY_BATCH)
+    telemetrySend();
+}
+
+void telemetryCommand(char* arg1, char* arg2)
+{
+  if (!telemetryOn)
+  {
+    logln("telemetry off - set telem_hz, save and reset");
+    return;
+  }
+  Serial.printf("telemetry %u Hz to port %u, WiFi %s %s, %u datagrams sent\n", telemetryRateHz, TELEMETRY_PORT,
+                WiFi.status() == WL_CONNECTED ? "connected" : "not connected",
+                WiFi.localIP().toString().c_str(), telemetrySent);
+}
+
+void telemetry_setup()
+{
+  console_add("telem", telemetryCommand);
+  telemetryRateHz = telemetryHz;
+  if (telemetryRateHz == 0)
+    return;
+
+  WiFi.mode(WIFI_STA);
+  WiFi.begin(TELEMETRY_SSID, TELEMETRY_PASSWORD); // connects in the background
+  telemetryUdp.begin(TELEMETRY_PORT);
+  telemetryOn = true;
+}
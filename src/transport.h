@@ -0,0 +1,172 @@
+/*
+  Byte sources - where a Brain gets its headset bytes from.
+
+  Every headset link (a wired UART, a Bluetooth SPP link, a recorded file, a test buffer)
+  is a ByteSource, and Brain::poll() drains whichever one it was given into the same parser.
+  So the wired and the wireless builds share one ingestion path, and captured headset data
+  can be played back through the real parser without a headset.
+
+  read() hands back a pointer to the bytes rather than copying them to the caller:
+    const uint8_t* data;
+    size_t n = source.read(&data, 64);   // n bytes at data - valid until the next read()
+  Sources that already hold the bytes in memory (MemorySource) return a pointer straight
+  into them; the others fill one internal buffer with a single bulk read.
+*/
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#ifdef ARDUINO
+  #include <Arduino.h>
+#else
+  #include <unistd.h>
+  #include <fcntl.h>
+#endif
+
+#define TRANSPORT_CHUNK 64   // bytes handed out per read() by the buffered sources
+
+class ByteSource
+{
+  public:
+    virtual ~ByteSource() {}
+    // Up to max bytes that have arrived - *data points at them until the next read(). 0 = none yet.
+    virtual size_t read(const uint8_t** data, size_t max) = 0;
+};
+
+// Bytes already in memory - a test packet, or a capture to replay (tools/framecheck). Zero copy.
+class MemorySource : public ByteSource
+{
+  public:
+    MemorySource(const uint8_t* bytes, size_t length, bool repeat = false)
+      : _bytes(bytes), _length(length), _pos(0), _repeat(repeat) {}
+
+    size_t read(const uint8_t** data, size_t max) override
+    {
+      if (_pos >= _length)
+      {
+        if (!_repeat || _length == 0)
+          return 0;
+        _pos = 0;
+      }
+      size_t n = _length - _pos;
+      if (n > max)
+        n = max;
+      *data = _bytes + _pos;
+      _pos += n;
+      return n;
+    }
+
+    void rewind() { _pos = 0; }
+
+  private:
+    const uint8_t* _bytes;
+    size_t _length;
+    size_t _pos;
+    bool _repeat;
+};
+
+#ifdef ARDUINO
+// Any Arduino Stream - BluetoothSerial (SPP), a LittleFS File, ...
+class StreamSource : public ByteSource
+{
+  public:
+    StreamSource(Stream& stream) : _stream(stream) {}
+
+    size_t read(const uint8_t** data, size_t max) override
+    {
+      int avail = _stream.available();
+      if (avail <= 0)
+        return 0;
+      size_t n = (size_t)avail;
+      if (n > max) n = max;
+      if (n > TRANSPORT_CHUNK) n = TRANSPORT_CHUNK;
+      n = _stream.readBytes(_buf, n); // won't wait - the bytes are already there
+      *data = _buf;
+      return n;
+    }
+
+  protected:
+    Stream& _stream;
+    uint8_t _buf[TRANSPORT_CHUNK];
+};
+
+// A wired headset on one of the ESP32 UARTs - one bulk read from the driver's ring buffer
+class UartSource : public ByteSource
+{
+  public:
+    UartSource(HardwareSerial& uart) : _uart(uart) {}
+
+    size_t read(const uint8_t** data, size_t max) override
+    {
+      int avail = _uart.available();
+      if (avail <= 0)
+        return 0;
+      size_t n = (size_t)avail;
+      if (n > max) n = max;
+      if (n > TRANSPORT_CHUNK) n = TRANSPORT_CHUNK;
+      n = _uart.read(_buf, n);
+      *data = _buf;
+      return n;
+    }
+
+  private:
+    HardwareSerial& _uart;
+    uint8_t _buf[TRANSPORT_CHUNK];
+};
+
+#ifdef TUG_BLUETOOTH
+#include <BluetoothSerial.h>
+// A headset fitted with an HC-05 module - the ESP32 connects as the SPP master ([env:bt]).
+// Note: BluetoothSerial holds one SPP connection, so this is one wireless headset per board -
+// headset A (serial_ap.h); B stays wired.
+class BluetoothSource : public StreamSource
+{
+  public:
+    BluetoothSource(BluetoothSerial& bt) : StreamSource(bt), _bt(bt), _begun(false) {}
+
+    bool connect(const char* name, const char* pin = "1234")
+    {
+      if (!_begun)
+      {
+        _bt.begin("TUG32", true); // true = master
+        _begun = true;
+      }
+      _bt.setPin(pin);
+      return _bt.connect(name);
+    }
+
+    bool connected() { return _bt.connected(); }
+
+  private:
+    BluetoothSerial& _bt;
+    bool _begun;
+};
+#endif
+
+#else
+// Host builds - a file or a pipe (e.g. a serial capture, or a live tty) - tools/framecheck replays one
+class FileSource : public ByteSource
+{
+  public:
+    FileSource(const char* path) { _fd = open(path, O_RDONLY | O_NONBLOCK); }
+    ~FileSource() { if (_fd >= 0) close(_fd); }
+
+    bool ok() const { return _fd >= 0; }
+
+    size_t read(const uint8_t** data, size_t max) override
+    {
+      if (_fd < 0)
+        return 0;
+      if (max > TRANSPORT_CHUNK) max = TRANSPORT_CHUNK;
+      ssize_t n = ::read(_fd, _buf, max);
+      if (n <= 0)
+        return 0;
+      *data = _buf;
+      return (size_t)n;
+    }
+
+  private:
+    int _fd;
+    uint8_t _buf[TRANSPORT_CHUNK];
+};
+#endif
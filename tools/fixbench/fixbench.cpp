@@ -0,0 +1,124 @@
+/*
+  fixbench - accuracy and speed of src/fixmath.h against the float / map() code it replaced.
+
+  Build:  g++ -O2 -o fixbench fixbench.cpp
+  Usage:  fixbench
+
+  Accuracy: every phase for sin15 / tri15, every input of the FixMaps the game uses, and the
+  waveforms the game draws (meter pulse, warble, attacking sound) over ten minutes of millis(),
+  each against the original float expression. Speed: ns per call of both versions.
+  Exits non zero if an error is over its limit.
+*/
+#include <cstdio>
+#include <cstdint>
+#include <cstdlib>
+#include <cmath>
+#include <chrono>
+#include "../../src/fixmath.h"
+
+#define PLAYERMAX 100
+
+// Arduino's map()
+static long map(long x, long in_min, long in_max, long out_min, long out_max)
+{
+  return (x - in_min) * (out_max - out_min) / (in_max - in_min) + out_min;
+}
+
+static int failures = 0;
+
+static void report(const char* name, double err, double limit, const char* unit)
+{
+  bool ok = err <= limit;
+  printf("  %-34s max error %8.4f %s  (limit %g)%s\n", name, err, unit, limit, ok ? "" : "  FAIL");
+  if (!ok)
+    failures++;
+}
+
+static volatile int32_t sink;
+
+template <typename F>
+static double nsPerCall(F f)
+{
+  const int n = 2000000;
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < n; i++)
+    sink = f(i);
+  auto end = std::chrono::steady_clock::now();
+  return std::chrono::duration<double, std::nano>(end - start).count() / n;
+}
+
+int main()
+{
+  printf("accuracy\n");
+  double err = 0;
+  for (int p = 0; p < 65536; p++)
+    err = fmax(err, fabs(sin15(p) / 32767.0 - sin(p * 2 * M_PI / 65536)));
+  report("sin15 vs sin", err, 0.0002, "");
+
+  err = 0;
+  for (int p = 0; p < 65536; p++)
+  {
+    double t = p / 65536.0;
+    double tri = t < 0.25 ? 4 * t : t < 0.75 ? 2 - 4 * t : 4 * t - 4;
+    err = fmax(err, fabs(tri15(p) / 32767.0 - tri));
+  }
+  report("tri15 vs triangle", err, 0.0002, "");
+
+  // the waveforms in the game, against the float code they replaced
+  double errMeter = 0, errWarble = 0, errAttack = 0, errMarch = 0;
+  for (uint32_t ms = 0; ms < 600000; ms++)
+  {
+    float phase1 = (ms % 1000) / 1000.0f;
+    int want = (sin(phase1 * 2 * M_PI) * 127.5 + 127.5);
+    errMeter = fmax(errMeter, abs(want - unit8(sin15(phaseAt(ms, PHASE_STEP_MS(1000))))));
+
+    int warble = 20;
+    want = map(sin(ms / 20.0) * 1000.0, -1000, 1000, 0, warble);
+    int got = (warble * ((int32_t)sin15(phaseAt(ms, PHASE_STEP_RAD(20.0))) + 32768)) >> 16;
+    errWarble = fmax(errWarble, abs(want - got));
+
+    want = map(sin(ms / 2.0) * 1000.0, -1000, 1000, 500, 600);
+    got = 500 + ((((int32_t)sin15(phaseAt(ms, PHASE_STEP_RAD(2.0))) + 32768) * 100) >> 16);
+    errAttack = fmax(errAttack, abs(want - got));
+
+    want = 20 + ((sin(ms / 5000.00) + 1) * 33);
+    got = 20 + ((((int32_t)sin15(phaseAt(ms, PHASE_STEP_RAD(5000.0))) + 32768) * 66) >> 16);
+    errMarch = fmax(errMarch, abs(want - got));
+  }
+  report("meter pulse (0..255)", errMeter, 2, "steps");
+  report("warble (0..20 Hz)", errWarble, 1, "Hz");
+  report("attacking (500..600 Hz)", errAttack, 1, "Hz");
+  report("LED_march hue (20..86)", errMarch, 1, "steps");
+
+  constexpr FixMap meter(0, PLAYERMAX, 0, 255);
+  constexpr FixMap attentionFreq(-100, +100, 80, 900);
+  err = 0;
+  for (int x = 0; x <= PLAYERMAX; x++)
+    err = fmax(err, abs(map(x, 0, PLAYERMAX, 0, 255) - meter(x)));
+  report("FixMap meter vs map", err, 0, "steps");
+  err = 0;
+  for (int x = 0; x <= 200; x++)
+    err = fmax(err, abs(map(x, -100, 100, 80, 900) - attentionFreq(x)));
+  report("FixMap attention freq vs map", err, 0, "Hz");
+
+  err = 0;
+  for (int t = -100; t <= 1100; t++)
+  {
+    long x = t < 0 ? 0 : t > 1000 ? 1000 : t;
+    err = fmax(err, abs(map(x, 0, 1000, 1000, 10) - fixLerp(1000, 10, (int32_t)(((int64_t)t << 16) / 1000))));
+  }
+  report("fixLerp vs map_constrain", err, 1, "Hz");
+
+  printf("speed (ns per call, this machine)\n");
+  printf("  %-34s float %6.2f   fixed %6.2f\n", "sine wave at millis()",
+         nsPerCall([](int ms) { return (int32_t)(sin(ms / 20.0) * 1000.0); }),
+         nsPerCall([](int ms) { return (int32_t)sin15(phaseAt(ms, PHASE_STEP_RAD(20.0))); }));
+  printf("  %-34s float %6.2f   fixed %6.2f\n", "meter pulse",
+         nsPerCall([](int ms) { float ph = (ms % 1000) / 1000.0f; return (int32_t)(sin(ph * 2 * M_PI) * 127.5 + 127.5); }),
+         nsPerCall([](int ms) { return (int32_t)unit8(sin15(phaseAt(ms, PHASE_STEP_MS(1000)))); }));
+  printf("  %-34s map   %6.2f   fixed %6.2f\n", "map 0..100 -> 0..255",
+         nsPerCall([](int x) { return (int32_t)map(x & 127, 0, PLAYERMAX, 0, 255); }),
+         nsPerCall([meter](int x) { return meter(x & 127); }));
+
+  return failures ? 1 : 0;
+}
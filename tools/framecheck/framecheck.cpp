@@ -0,0 +1,250 @@
+/*
+  framecheck - the headset parser (src/Brain.cpp) on the host: framing, checksum, fields, queue.
+
+  Build:  g++ -O2 -Istub -I../../src -o framecheck framecheck.cpp ../../src/Brain.cpp
+  Usage:  framecheck
+
+  A stream of 300 packets - band power packets (36 bytes on the wire, like a headset's 1 Hz
+  packet, some with a poor signal) between raw sample packets, with stray bytes in between -
+  is fed through Brain::poll() in reads of every size from 1 to 64 bytes. The source hands
+  out its bytes from one buffer it scribbles over before every read, as UartSource reuses its
+  buffer, so a payload parsed in place after its read was gone would show up as bad fields.
+  Checked after every read: every band power packet comes out of the queue once, in order,
+  with the right fields; raw packets are counted but not queued. The stream is then played
+  from a MemorySource (transport.h) a slice at a time, and through a pipe read by a
+  FileSource (as a live tty or a capture being written would be). Then ns per packet for one
+  byte reads and for whole chunk reads (where a payload is parsed without a copy).
+  Exits non zero on a mismatch.
+*/
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+#include <chrono>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include "Brain.h"
+
+Stream Serial;
+uint8_t averagingLength = DEFAULT_AVERAGING_LENGTH;
+uint8_t qualityGate = DEFAULT_QUALITY_GATE;
+
+#define PACKETS 300
+#define SLICE 200     // MemorySource bytes per poll - fewer packets than the queue holds
+
+// a read of 'chunk' bytes per poll, from a buffer that is overwritten every read
+class ChunkSource : public ByteSource
+{
+  public:
+    ChunkSource(const std::vector<uint8_t>& bytes, size_t chunk) : _bytes(bytes), _chunk(chunk), _pos(0), _reads(0) {}
+
+    size_t read(const uint8_t** data, size_t max) override
+    {
+      memset(_buf, 0xEE, sizeof(_buf));
+      if (_reads == 0 || _pos >= _bytes.size())
+        return 0;
+      _reads--;
+      size_t n = _bytes.size() - _pos;
+      if (n > _chunk) n = _chunk;
+      if (n > max) n = max;
+      memcpy(_buf, &_bytes[_pos], n);
+      _pos += n;
+      *data = _buf;
+      return n;
+    }
+
+    void allow(int reads) { _reads = reads; }
+    bool done() const { return _pos >= _bytes.size(); }
+
+  private:
+    const std::vector<uint8_t>& _bytes;
+    size_t _chunk;
+    size_t _pos;
+    int _reads;
+    uint8_t _buf[TRANSPORT_CHUNK];
+};
+
+static uint8_t qualityOf(int k) { return k % 6 == 0 ? 30 : 0; }
+static uint8_t attentionOf(int k) { return k % 100; }
+static uint32_t powerOf(int k, int band) { return (uint32_t)(band * 40503 + k * 977) & 0xFFFFFF; }
+
+static void packet(std::vector<uint8_t>& out, int k)
+{
+  uint8_t p[MAX_PACKET_LENGTH];
+  int m = 0;
+  if (k % 2)
+  {// raw sample
+    p[m++] = 0x80; p[m++] = 2; p[m++] = 0x01; p[m++] = (uint8_t)k;
+  }
+  else
+  {
+    p[m++] = 0x02; p[m++] = qualityOf(k);
+    p[m++] = 0x83; p[m++] = 24;
+    for (int b = 0; b < EEG_POWER_BANDS; b++)
+    {
+      uint32_t v = powerOf(k, b);
+      p[m++] = v >> 16; p[m++] = v >> 8; p[m++] = v;
+    }
+    p[m++] = 0x04; p[m++] = attentionOf(k);
+    p[m++] = 0x05; p[m++] = 40;
+  }
+  out.push_back(0xAA);
+  out.push_back(0xAA);
+  out.push_back(m);
+  uint8_t sum = 0;
+  for (int i = 0; i < m; i++)
+  {
+    out.push_back(p[i]);
+    sum += p[i];
+  }
+  out.push_back(255 - sum);
+}
+
+static int failures = 0;
+
+static void fail(const char* what, size_t chunk, int k)
+{
+  if (failures++ < 10)
+    printf("  FAIL %s - reads of %zu, packet %d\n", what, chunk, k);
+}
+
+int main()
+{
+  std::vector<uint8_t> stream;
+  for (int k = 0; k < PACKETS; k++)
+  {
+    packet(stream, k);
+    if (k % 7 == 0)
+      stream.push_back(0x55); // a stray byte between packets
+  }
+
+  for (size_t chunk = 1; chunk <= TRANSPORT_CHUNK; chunk++)
+  {
+    Brain brain("T");
+    ChunkSource source(stream, chunk);
+    brain.setSource(&source);
+    BrainPacket p;
+    int next = 0; // the band power packet expected next
+    while (!source.done())
+    {
+      source.allow(1);
+      brain.poll();
+      while (brain.nextPacket(p))
+      {
+        if (next >= PACKETS)
+        {
+          fail("extra packet", chunk, next);
+          break;
+        }
+        bool ok = p.fields == (BRAIN_HAS_QUALITY | BRAIN_HAS_ATTENTION | BRAIN_HAS_MEDITATION | BRAIN_HAS_POWER) &&
+                  p.signalQuality == qualityOf(next) && p.attention == attentionOf(next) && p.meditation == 40;
+        for (int b = 0; b < EEG_POWER_BANDS; b++)
+          ok &= p.eegPower[b] == powerOf(next, b);
+        if (!ok)
+          fail("fields", chunk, next);
+        brain.consume(p);
+        next += 2;
+      }
+    }
+    if (next != PACKETS)
+      fail("band power packets", chunk, next);
+    if (brain.packetSeq != PACKETS || brain.rawSeen != PACKETS / 2 || brain.packetsDropped != 0)
+      fail("counts", chunk, brain.packetSeq);
+  }
+  printf("%d packets, reads of 1..%d bytes\n", PACKETS, TRANSPORT_CHUNK);
+
+  // the same stream from a MemorySource (zero copy), a slice at a time as if arriving
+  {
+    Brain brain("T");
+    BrainPacket p;
+    int next = 0;
+    for (size_t at = 0; at < stream.size(); at += SLICE)
+    {
+      size_t n = stream.size() - at < SLICE ? stream.size() - at : SLICE;
+      MemorySource source(&stream[at], n);
+      brain.setSource(&source);
+      brain.poll();
+      while (brain.nextPacket(p))
+      {
+        if (next >= PACKETS || p.attention != attentionOf(next) || p.eegPower[EEG_POWER_BANDS - 1] != powerOf(next, EEG_POWER_BANDS - 1))
+          fail("MemorySource fields", SLICE, next);
+        brain.consume(p);
+        next += 2;
+      }
+    }
+    if (next != PACKETS || brain.packetSeq != PACKETS || brain.packetsDropped != 0)
+      fail("MemorySource counts", SLICE, next);
+    printf("%d packets from a MemorySource, %d bytes at a time\n", PACKETS, SLICE);
+  }
+
+  // and from a FileSource on a pipe - a slice written, then polled, as bytes would trickle in
+  {
+    char path[64];
+    snprintf(path, sizeof(path), "/tmp/framecheck.%d", (int)getpid());
+    unlink(path);
+    if (mkfifo(path, 0600) != 0)
+      fail("can't make a pipe", 0, 0);
+    else
+    {
+      FileSource source(path);  // read end first - non blocking, so it opens with no writer yet
+      int w = open(path, O_WRONLY | O_NONBLOCK);
+      if (!source.ok() || w < 0)
+        fail("can't open the pipe", 0, 0);
+      else
+      {
+        Brain brain("T");
+        brain.setSource(&source);
+        BrainPacket p;
+        int next = 0;
+        for (size_t at = 0; at < stream.size(); at += SLICE)
+        {
+          size_t n = stream.size() - at < SLICE ? stream.size() - at : SLICE;
+          if (write(w, &stream[at], n) != (ssize_t)n)
+            fail("pipe write", SLICE, next);
+          brain.poll();
+          while (brain.nextPacket(p))
+          {
+            if (next >= PACKETS || p.attention != attentionOf(next) || p.eegPower[EEG_POWER_BANDS - 1] != powerOf(next, EEG_POWER_BANDS - 1))
+              fail("FileSource fields", SLICE, next);
+            brain.consume(p);
+            next += 2;
+          }
+        }
+        if (next != PACKETS || brain.packetSeq != PACKETS || brain.packetsDropped != 0)
+          fail("FileSource counts", SLICE, next);
+        printf("%d packets from a FileSource on a pipe, %d bytes at a time\n", PACKETS, SLICE);
+      }
+      if (w >= 0)
+        close(w);
+    }
+    unlink(path);
+  }
+
+  const size_t sizes[] = {1, TRANSPORT_CHUNK};
+  for (size_t chunk : sizes)
+  {
+    const int rounds = 2000;
+    Brain brain("T");
+    BrainPacket p;
+    auto start = std::chrono::steady_clock::now();
+    for (int r = 0; r < rounds; r++)
+    {
+      ChunkSource source(stream, chunk);
+      brain.setSource(&source);
+      while (!source.done())
+      {
+        source.allow(1);
+        brain.poll();
+        while (brain.nextPacket(p))
+          ;
+      }
+    }
+    auto end = std::chrono::steady_clock::now();
+    printf("  reads of %2zu bytes: %.0f ns a packet\n", chunk,
+           std::chrono::duration<double, std::nano>(end - start).count() / (rounds * PACKETS));
+  }
+
+  printf("%s\n", failures ? "FAILED" : "ok");
+  return failures ? 1 : 0;
+}
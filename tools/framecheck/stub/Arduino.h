@@ -0,0 +1,37 @@
+// Just enough of Arduino for src/Brain.cpp and src/Particle.h on the host - tools/framecheck, tools/hostbench
+#pragma once
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <cstddef>
+#include <chrono>
+
+typedef bool boolean;
+#define IRAM_ATTR
+#define DEC 10
+#define HEX 16
+
+inline uint32_t micros()
+{
+  static auto start = std::chrono::steady_clock::now();
+  return (uint32_t)std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+}
+inline unsigned long millis() { return micros() / 1000; }
+inline long map(long x, long inMin, long inMax, long outMin, long outMax)
+{
+  return (x - inMin) * (outMax - outMin) / (inMax - inMin) + outMin;
+}
+
+// the parser only logs - swallow it
+struct Stream
+{
+  template <class T> void print(T) {}
+  template <class T> void print(T, int) {}
+  template <class T> void println(T) {}
+  template <class T> void println(T, int) {}
+  void println() {}
+  int printf(const char*, ...) { return 0; }
+};
+extern Stream Serial;
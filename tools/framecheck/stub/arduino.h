@@ -0,0 +1,2 @@
+// config.h includes <arduino.h>
+#include "Arduino.h"
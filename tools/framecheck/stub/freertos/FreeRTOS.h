@@ -0,0 +1,4 @@
+// host stand in - tools/framecheck
+#pragma once
+#define pdTRUE 1
+#define pdFALSE 0
@@ -0,0 +1,36 @@
+// host stand in for a FreeRTOS queue - one task, so no locking - tools/framecheck
+#pragma once
+#include <cstdlib>
+#include <cstring>
+
+struct HostQueue
+{
+  size_t length, itemSize, head, count;
+  unsigned char* items;
+};
+typedef HostQueue* QueueHandle_t;
+
+inline QueueHandle_t xQueueCreate(size_t length, size_t itemSize)
+{
+  HostQueue* q = new HostQueue{length, itemSize, 0, 0, (unsigned char*)malloc(length * itemSize)};
+  return q;
+}
+
+inline int xQueueSend(QueueHandle_t q, const void* item, int)
+{
+  if (q->count == q->length)
+    return pdFALSE;
+  memcpy(q->items + (q->head + q->count) % q->length * q->itemSize, item, q->itemSize);
+  q->count++;
+  return pdTRUE;
+}
+
+inline int xQueueReceive(QueueHandle_t q, void* item, int)
+{
+  if (q->count == 0)
+    return pdFALSE;
+  memcpy(item, q->items + q->head * q->itemSize, q->itemSize);
+  q->head = (q->head + 1) % q->length;
+  q->count--;
+  return pdTRUE;
+}
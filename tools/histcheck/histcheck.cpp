@@ -0,0 +1,133 @@
+/*
+  histcheck - checks src/history.h against a brute force reference and measures the packing.
+
+  Build:  g++ -O2 -o histcheck histcheck.cpp
+  Usage:  histcheck [packets]      (2000 unless given)
+
+  Feeds packets that look like a headset's (band powers wandering over 24 bits with spikes,
+  attention and quality in their ranges) and after every one checks:
+    - historyWindow() for every field and a spread of window lengths: min / mean / max equal
+      the reference over the same count of newest records, and count is n rounded down by
+      less than the bucket size it reached (or everything the tiers keep)
+    - historyNext() hands back exactly the newest historyLogged() records
+  Then prints bytes per packet, how many minutes the log holds at one packet a second, and ns
+  per window query. Exits non zero on a mismatch.
+*/
+#include <cstdio>
+#include <cstdint>
+#include <cstdlib>
+#include <chrono>
+#include <vector>
+#include "../../src/history.h"
+
+static uint32_t seed = 12345;
+static uint32_t next()
+{
+  seed ^= seed << 13;
+  seed ^= seed >> 17;
+  seed ^= seed << 5;
+  return seed;
+}
+
+static int failures = 0;
+
+static void fail(const char* what, uint32_t packet, uint32_t n, int field)
+{
+  if (failures++ < 10)
+    printf("  FAIL %s - packet %u, window %u, field %d\n", what, packet, n, field);
+}
+
+int main(int argc, char** argv)
+{
+  uint32_t packets = argc > 1 ? atoi(argv[1]) : 2000;
+  static History h;
+  historyClear(h);
+  std::vector<HistoryRecord> all;
+
+  HistoryRecord r = {};
+  uint32_t band[HISTORY_BANDS];
+  for (int b = 0; b < HISTORY_BANDS; b++)
+    band[b] = next() & 0xFFFF;
+
+  const uint32_t windows[] = {1, 2, 3, 4, 5, 7, 15, 16, 17, 31, 60, 63, 64, 65, 100, 127, 200, 300, 511, 600, 5000};
+  for (uint32_t i = 0; i < packets; i++)
+  {
+    r.ms += 1000 + (next() % 40) - 20;   // about once a second
+    for (int b = 0; b < HISTORY_BANDS; b++)
+    {
+      int32_t step = (int32_t)(next() % 20001) - 10000;
+      int64_t v = (int64_t)band[b] + step;
+      if (next() % 50 == 0)
+        v = next() & 0xFFFFFF;             // the odd spike
+      band[b] = v < 0 ? 0 : v > 0xFFFFFF ? 0xFFFFFF : (uint32_t)v;
+      r.value[b] = band[b];
+    }
+    r.value[HIST_ATTENTION] = next() % 101;
+    r.value[HIST_QUALITY] = next() % 4 ? 0 : next() % 201;
+    historyAdd(h, r);
+    all.push_back(r);
+
+    for (uint32_t n : windows)
+    {
+      for (int f = 0; f < HISTORY_FIELDS; f++)
+      {
+        HistoryStats s = historyWindow(h, (HistoryField)f, n);
+        uint32_t want = n < all.size() ? n : all.size();
+        uint32_t bucketTop = historyBucketSize(HISTORY_TIERS - 1);
+        uint32_t kept = HISTORY_TIER_BUCKETS * bucketTop;
+        if (s.count > want || (want - s.count >= bucketTop && s.count + bucketTop <= kept))
+          fail("count", i, n, f);
+        uint32_t mn = UINT32_MAX, mx = 0;
+        uint64_t sum = 0;
+        for (uint32_t k = all.size() - s.count; k < all.size(); k++)
+        {
+          uint32_t v = all[k].value[f];
+          mn = v < mn ? v : mn;
+          mx = v > mx ? v : mx;
+          sum += v;
+        }
+        if (s.count && (s.min != mn || s.max != mx || s.mean != sum / s.count))
+          fail("min/mean/max", i, n, f);
+      }
+    }
+
+    if (i % 97 == 0 || i == packets - 1)
+    {
+      HistoryCursor c;
+      historyCursorStart(h, c);
+      uint32_t logged = historyLogged(h);
+      uint32_t k = all.size() - logged;
+      HistoryRecord got;
+      while (historyNext(h, c, got))
+      {
+        if (k >= all.size() || memcmp(&got, &all[k], sizeof(got)) != 0)
+        {
+          fail("replay", i, k, -1);
+          break;
+        }
+        k++;
+      }
+      if (k != all.size())
+        fail("replay length", i, k, -1);
+    }
+  }
+
+  uint32_t logged = historyLogged(h);
+  uint32_t bytes = historyLogBytes(h);
+  printf("%u packets\n", packets);
+  printf("  log: %u packets in %u bytes - %.1f bytes a packet (unpacked %u), %.1f minutes at 1 Hz\n",
+         logged, bytes, (double)bytes / logged, (unsigned)sizeof(HistoryRecord), logged / 60.0);
+  printf("  store: %u bytes a player\n", (unsigned)sizeof(History));
+
+  const int n = 200000;
+  volatile uint32_t sink = 0;
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < n; i++)
+    sink = historyWindow(h, HIST_ATTENTION, 1 + i % 512).mean;
+  auto end = std::chrono::steady_clock::now();
+  printf("  window query: %.1f ns\n", std::chrono::duration<double, std::nano>(end - start).count() / n);
+  (void)sink;
+
+  printf("%s\n", failures ? "FAILED" : "ok");
+  return failures ? 1 : 0;
+}
@@ -0,0 +1,183 @@
+/*
+  hostbench - the hot path benchmarks of src/bench.h that build on the host, timed by wall clock.
+
+  Build:  g++ -O2 -I../framecheck/stub -I../../src -o hostbench hostbench.cpp ../../src/Brain.cpp
+  Usage:  hostbench > host.json
+
+  The same code as the board runs (Brain.cpp, RollingAverage.h, Particle.h, over the stubs of
+  tools/framecheck) with the same iterations, printed as the same JSON as [env:bench] between
+  BENCH_BEGIN and BENCH_END, with "target": "host" - so a change can be timed before it goes on
+  a board, and two host runs diffed with the same script. Covered: brain_update_byte / packet /
+  chunk, brain_consume, approximate_attention, rolling_average_add, particle_tick_pool.
+  FastLED, the sound and the strip need the board.
+
+  On x86 an iteration is timed with the TSC, so "cycles" are TSC ticks and cpu_mhz is the TSC
+  rate measured at the start; elsewhere "cycles" are nanoseconds and cpu_mhz is 1000. A host is
+  not an ESP32 - compare host runs with host runs, and take the numbers that decide something
+  from the board.
+*/
+#include <cstdio>
+#include <cstdint>
+#include <chrono>
+#include "Brain.h"
+#include "RollingAverage.h"
+#include "Particle.h"
+#include "rng.h"
+#if defined(__x86_64__) || defined(__i386__)
+  #include <x86intrin.h>
+#endif
+
+#define BENCH_REPEAT 200     // as src/bench.h
+#define PARTICLE_COUNT 100   // as src/arena.h
+
+Stream Serial;
+uint8_t averagingLength = DEFAULT_AVERAGING_LENGTH;
+uint8_t qualityGate = DEFAULT_QUALITY_GATE;
+uint16_t led_count = NUM_LEDS;
+
+static inline uint64_t benchCycles()
+{
+#if defined(__x86_64__) || defined(__i386__)
+  return __rdtsc();
+#else
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+// ticks of benchCycles() per microsecond
+static uint32_t benchMhz()
+{
+#if defined(__x86_64__) || defined(__i386__)
+  auto t0 = std::chrono::steady_clock::now();
+  uint64_t c0 = __rdtsc();
+  while (std::chrono::steady_clock::now() - t0 < std::chrono::milliseconds(50))
+    ;
+  uint64_t c1 = __rdtsc();
+  double us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - t0).count();
+  return (uint32_t)((c1 - c0) / us + 0.5);
+#else
+  return 1000;
+#endif
+}
+
+struct BenchResult
+{
+  uint64_t best;
+  uint64_t worst;
+  uint64_t total;
+  uint32_t count;
+};
+
+static bool benchFirst = true;
+static uint32_t cpuMhz = 1000;
+
+static void benchBegin(BenchResult& r)
+{
+  r.best = UINT64_MAX;
+  r.worst = 0;
+  r.total = 0;
+  r.count = 0;
+}
+
+static inline void benchAdd(BenchResult& r, uint64_t cycles)
+{
+  if (cycles < r.best) r.best = cycles;
+  if (cycles > r.worst) r.worst = cycles;
+  r.total += cycles;
+  r.count++;
+}
+
+static void benchReport(const char* name, const BenchResult& r, const char* unit)
+{
+  uint64_t mean = r.count ? r.total / r.count : 0;
+  printf("%s\n    {\"name\": \"%s\", \"unit\": \"%s\", \"iterations\": %u, \"cycles_best\": %llu, \"cycles_mean\": %llu, \"cycles_worst\": %llu, \"ns_mean\": %llu}",
+         benchFirst ? "" : ",", name, unit, r.count, (unsigned long long)r.best, (unsigned long long)mean,
+         (unsigned long long)r.worst, (unsigned long long)(mean * 1000 / cpuMhz));
+  benchFirst = false;
+}
+
+// times one call of 'body' per iteration - as src/bench.h
+#define BENCH(name, unit, iterations, body)         \
+  {                                                 \
+    BenchResult r;                                  \
+    benchBegin(r);                                  \
+    for (int it = 0; it < (iterations); it++)       \
+    {                                               \
+      uint64_t t0 = benchCycles();                  \
+      body;                                         \
+      benchAdd(r, benchCycles() - t0);              \
+    }                                               \
+    benchReport(name, r, unit);                     \
+  }
+
+// the packet of src/bench.h - quality, attention, meditation and the eight band powers
+static uint8_t benchPacket(uint8_t* buf)
+{
+  uint8_t n = 0;
+  buf[n++] = 0xAA;
+  buf[n++] = 0xAA;
+  buf[n++] = 32;                 // payload length
+  uint8_t* payload = buf + n;
+  payload[0] = 0x02; payload[1] = 0;      // perfect signal - no estimate printed
+  payload[2] = 0x83; payload[3] = 24;
+  for (int i = 0; i < 24; i++)
+    payload[4 + i] = (uint8_t)(i * 37 + 11);
+  payload[28] = 0x04; payload[29] = 55;   // attention
+  payload[30] = 0x05; payload[31] = 40;   // meditation
+  uint8_t sum = 0;
+  for (int i = 0; i < 32; i++)
+    sum += payload[i];
+  n += 32;
+  buf[n++] = 255 - sum;          // checksum
+  return n;
+}
+
+int main()
+{
+  cpuMhz = benchMhz();
+  printf("BENCH_BEGIN\n");
+  printf("{\"target\": \"host\", \"version\": \"%s\", \"cpu_mhz\": %u, \"leds\": %u, \"arenas\": 1, \"frame_us\": %u, ",
+         VERSION, cpuMhz, led_count, FRAME_INTERVAL_US);
+  printf("\"boot_us\": {}, \"results\": [");
+
+  // ---- input ----
+  {
+    static Brain benchBrain("bench");
+    uint8_t packet[40];
+    uint8_t len = benchPacket(packet);
+    int b = 0;
+    BrainPacket queued;
+    BENCH("brain_update_byte", "byte", BENCH_REPEAT * len,
+          benchBrain.update(packet[b]); b = (b + 1) % len; if (b == 0) benchBrain.nextPacket(queued));
+    BENCH("brain_update_packet", "packet", BENCH_REPEAT,
+          for (int i = 0; i < len; i++) benchBrain.update(packet[i]); benchBrain.nextPacket(queued));
+    BENCH("brain_update_chunk", "packet", BENCH_REPEAT, benchBrain.update(packet, len); benchBrain.nextPacket(queued));
+    BENCH("brain_consume", "packet", BENCH_REPEAT, benchBrain.consume(queued));
+  }
+  {
+    volatile uint8_t att;
+    uint32_t p = 1000;
+    BENCH("approximate_attention", "call", BENCH_REPEAT,
+          att = approximateAttention(p, p * 2, p * 3, p, p * 5, p * 2, p, p / 2, 20); p += 97);
+  }
+  {
+    RollingAverage<uint8_t, MAX_AVERAGING_LENGTH> avg;
+    avg.setWindow(averagingLength);
+    volatile double a;
+    BENCH("rolling_average_add", "call", BENCH_REPEAT, avg.add((uint8_t)it); a = avg.getAverage());
+  }
+
+  // ---- render ----
+  {
+    static Particle particles[PARTICLE_COUNT];
+    rng_seed(1);
+    for (int p = 0; p < PARTICLE_COUNT; p++)
+      particles[p].Spawn(led_count / 2);
+    BENCH("particle_tick_pool", "frame", BENCH_REPEAT,
+          for (int p = 0; p < PARTICLE_COUNT; p++) particles[p].Tick());
+  }
+
+  printf("\n]}\n");
+  printf("BENCH_END\n");
+  return 0;
+}
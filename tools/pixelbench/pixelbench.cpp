@@ -0,0 +1,118 @@
+/*
+  pixelbench - checks and times the pixel pipeline (src/pixels.h) against a per pixel model of FastLED's path.
+
+  Build:  g++ -O2 -o pixelbench pixelbench.cpp
+  Usage:  pixelbench [leds]      (144 unless given)
+
+  The "FastLED" path here is a hand written model of what the show task did per pixel - a
+  per pixel scale8, min-white split and reorder - not FastLED itself, which isn't built on
+  the host. So the first part only checks that the table and the loop in pixelsConvert()
+  give what the straightforward code gives; whether that is FastLED's output is checked on
+  the board against FastLED's own functions ([env:bench], "pixels_vs_fastled" in bench.h).
+  1. Model check - every one of the 16.7M colours at several brightnesses, through both
+     paths, for the RGBW strip and the RGB strip.
+  2. Cost - ns per frame of each path over random frames (the model is about what FastLED
+     did per pixel, so this is a rough comparison).
+  Exits non zero if any byte differs.
+*/
+#include <cstdio>
+#include <cstdint>
+#include <cstdlib>
+#include <chrono>
+#include <vector>
+#include <initializer_list>
+#include "../../src/pixels.h"
+
+#define GRB 0102
+
+// FastLED's path, one pixel at a time
+static inline uint8_t scale8(uint8_t v, uint8_t scale) { return (v * (scale + 1)) >> 8; }
+
+static void fastledPixel(const uint8_t* rgb, uint8_t* out, uint8_t brightness, uint16_t order, bool rgbw)
+{
+  uint8_t v[3] = {scale8(rgb[0], brightness), scale8(rgb[1], brightness), scale8(rgb[2], brightness)};
+  if (rgbw)
+  {
+    uint8_t w = v[0];
+    if (v[1] < w) w = v[1];
+    if (v[2] < w) w = v[2];
+    v[0] -= w; v[1] -= w; v[2] -= w;
+    out[3] = w;
+  }
+  out[0] = v[(order >> 6) & 7];
+  out[1] = v[(order >> 3) & 7];
+  out[2] = v[order & 7];
+}
+
+static void fastledConvert(const uint8_t* rgb, uint8_t* out, size_t count, uint8_t brightness, uint16_t order, bool rgbw)
+{
+  for (size_t i = 0; i < count; i++, rgb += 3, out += rgbw ? 4 : 3)
+    fastledPixel(rgb, out, brightness, order, rgbw);
+}
+
+static long checkAll(uint8_t brightness, bool rgbw)
+{
+  uint8_t lut[256];
+  pixelsBuildLut(lut, brightness, 1.0f);
+  long bad = 0;
+  std::vector<uint8_t> rgb(256 * 3), a(256 * 4), b(256 * 4);
+  for (int r = 0; r < 256; r++)
+    for (int g = 0; g < 256; g++)
+    {
+      for (int x = 0; x < 256; x++)
+      {
+        rgb[x * 3] = r; rgb[x * 3 + 1] = g; rgb[x * 3 + 2] = x;
+      }
+      pixelsConvert(lut, rgb.data(), a.data(), 256, GRB, rgbw);
+      fastledConvert(rgb.data(), b.data(), 256, brightness, GRB, rgbw);
+      for (size_t i = 0; i < 256u * (rgbw ? 4 : 3); i++)
+        bad += a[i] != b[i];
+    }
+  return bad;
+}
+
+template <typename F>
+static double timeFrames(F convert, int frames)
+{
+  auto start = std::chrono::steady_clock::now();
+  for (int f = 0; f < frames; f++)
+    convert(f);
+  auto end = std::chrono::steady_clock::now();
+  return std::chrono::duration<double, std::nano>(end - start).count() / frames;
+}
+
+int main(int argc, char** argv)
+{
+  int leds = argc > 1 ? atoi(argv[1]) : 144;
+
+  long bad = 0;
+  for (int brightness : {255, 150, 100, 64, 1})
+    for (bool rgbw : {true, false})
+    {
+      long n = checkAll(brightness, rgbw);
+      printf("model check  brightness %3d %-4s  %s\n", brightness, rgbw ? "rgbw" : "rgb", n ? "DIFFERS" : "same as the per pixel code");
+      bad += n;
+    }
+
+  const int frames = 20000;
+  const int variants = 16;
+  std::vector<uint8_t> rgb((size_t)leds * 3 * variants), out((size_t)leds * 4);
+  srand(1);
+  for (auto& v : rgb)
+    v = rand();
+  uint8_t lut[256];
+  pixelsBuildLut(lut, 150, 1.0f);
+
+  for (bool rgbw : {true, false})
+  {
+    double tLut = timeFrames([&](int f) {
+      pixelsConvert(lut, &rgb[(f % variants) * leds * 3], out.data(), leds, GRB, rgbw);
+    }, frames);
+    double tFastled = timeFrames([&](int f) {
+      fastledConvert(&rgb[(f % variants) * leds * 3], out.data(), leds, 150, GRB, rgbw);
+    }, frames);
+    printf("cost %-4s %d leds  fastled path %8.0f ns/frame   lut pipeline %8.0f ns/frame\n",
+           rgbw ? "rgbw" : "rgb", leds, tFastled, tLut);
+  }
+  return bad ? 1 : 0;
+}
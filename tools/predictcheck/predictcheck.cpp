@@ -0,0 +1,332 @@
+/*
+  predictcheck - the input predictor (src/predictor.h) against getAverage() on packet traces.
+
+  Build:  g++ -O2 -o predictcheck predictcheck.cpp
+  Usage:  predictcheck [-tune] [capture...]
+
+  A capture is the serial output of the "history dump" console command (the player,ms,
+  attention,quality lines between HISTORY_BEGIN and HISTORY_END) - a few minutes of real
+  packets per headset. With no captures, synthetic matches are used instead: a player's
+  attention wandering smoothly, sent once a second with noise, jittered arrival, dropped
+  packets and stretches of poor signal (estimated attention - noisier, lower quality).
+  There are two sets of synthetic matches from different seeds: -tune runs the tuning set,
+  the one to sweep the PREDICT_ gains on; without it the held out set is run, which the
+  gains were not chosen on - that is the one the pass / fail is for.
+
+  Both inputs are run at 60 frames a second from the same packets:
+    average    getAverage() - the mean of the last DEFAULT_AVERAGING_LENGTH packets, held
+    predictor  predictorSample() at each packet, predictorTick() every frame
+  and compared with what the player was actually doing (the synthetic signal, or for a
+  capture the packets joined with straight lines):
+    lag        the delay that best lines the input up with the player - the effective latency
+    error      RMS error at that delay, and with none
+    step       mean and largest change of the input from one frame to the next
+    reversals  how often a tug of war puck (drawPlayers() physics, headsets A against B)
+               changes direction, per minute - lower is a steadier puck
+  Exits non zero if the predictor has more lag, bigger frame steps or more puck reversals
+  than the average. The predictor's gains are tuned on the synthetic matches so that it
+  loses some of the lag without making the puck any less steady; check them on captures.
+*/
+#include <cstdio>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <vector>
+#include "../../src/predictor.h"
+
+#define FRAME_MS (1000.0 / 60)
+#define AVERAGING 5                   // DEFAULT_AVERAGING_LENGTH
+#define QUALITY_GATE 55               // DEFAULT_QUALITY_GATE
+#define LEDS 144
+#define MAX_LAG_MS 5000
+
+struct Packet
+{
+  uint32_t ms;
+  uint8_t attention;
+  uint8_t quality;
+};
+
+struct Player
+{
+  std::vector<Packet> packets;
+  std::vector<double> truth;         // per frame - what the player was doing
+  std::vector<int> average;          // per frame - the two inputs
+  std::vector<int> predicted;
+};
+
+#define SEED_TUNE 12345             // the synthetic matches the gains are swept on
+#define SEED_HELD_OUT 20261019        // ... and the ones they are checked on
+
+static uint32_t seed = SEED_HELD_OUT;
+static double uniform()
+{
+  seed ^= seed << 13;
+  seed ^= seed >> 17;
+  seed ^= seed << 5;
+  return (seed & 0xFFFFFF) / (double)0x1000000;
+}
+static double gaussian()
+{
+  double u = uniform() + 1e-9, v = uniform();
+  return sqrt(-2 * log(u)) * cos(2 * M_PI * v);
+}
+
+// a synthetic player - truth per frame, packets about once a second
+static Player synthetic(int frames)
+{
+  Player p;
+  double x = 30 + 40 * uniform(), v = 0;
+  for (int f = 0; f < frames; f++)
+  {
+    double dt = FRAME_MS / 1000;
+    v += (-0.4 * v) * dt + 6.0 * gaussian() * sqrt(dt);  // rate wanders, pulled back to 0
+    x += v * dt;
+    if (x < 5) { x = 5; v = fabs(v); }
+    if (x > 95) { x = 95; v = -fabs(v); }
+    p.truth.push_back(x);
+  }
+  int poor = 0;
+  for (double t = 500 + 1000 * uniform(); t < frames * FRAME_MS; t += 1000)
+  {
+    if (poor == 0 && uniform() < 0.03)
+      poor = 5 + (int)(uniform() * 15);               // a stretch of poor signal
+    if (uniform() < 0.03)
+      continue;                                       // packet lost
+    double sent = p.truth[(int)(t / FRAME_MS)];
+    uint8_t quality = 0;
+    double noise = 3;
+    if (poor > 0)
+    {
+      poor--;
+      quality = 20 + (uint8_t)(uniform() * 30);
+      noise = 12;
+    }
+    double a = sent + noise * gaussian();
+    a = a < 0 ? 0 : a > 100 ? 100 : a;
+    uint32_t arrived = (uint32_t)(t + 30 * uniform());
+    p.packets.push_back({arrived, (uint8_t)lround(a), quality});
+  }
+  return p;
+}
+
+// a capture - packets only; the truth is the packets joined up
+static bool readCapture(const char* path, Player players[2])
+{
+  FILE* f = fopen(path, "r");
+  if (!f)
+    return false;
+  char line[128];
+  while (fgets(line, sizeof(line), f))
+  {
+    char who;
+    unsigned ms, att, q;
+    if (sscanf(line, "%c,%u,%u,%u", &who, &ms, &att, &q) == 4 && (who == 'A' || who == 'B'))
+      players[who - 'A'].packets.push_back({ms, (uint8_t)att, (uint8_t)q});
+  }
+  fclose(f);
+  return true;
+}
+
+static void joinPackets(Player& p, uint32_t startMs, int frames)
+{
+  p.truth.assign(frames, 0);
+  size_t k = 0;
+  for (int f = 0; f < frames; f++)
+  {
+    double t = startMs + f * FRAME_MS;
+    while (k + 1 < p.packets.size() && p.packets[k + 1].ms <= t)
+      k++;
+    const Packet& a = p.packets[k];
+    if (k + 1 >= p.packets.size() || t < a.ms)
+      p.truth[f] = a.attention;
+    else
+    {
+      const Packet& b = p.packets[k + 1];
+      p.truth[f] = a.attention + (b.attention - a.attention) * (t - a.ms) / (b.ms - a.ms);
+    }
+  }
+}
+
+// both inputs, frame by frame, from the packets
+static void run(Player& p, uint32_t startMs, int frames)
+{
+  int window[AVERAGING];
+  int count = 0, next = 0, average = 0;
+  Predictor pr = {};
+  size_t k = 0;
+  p.average.clear();
+  p.predicted.clear();
+  for (int f = 0; f < frames; f++)
+  {
+    uint32_t ms = startMs + (uint32_t)(f * FRAME_MS);
+    for (; k < p.packets.size() && p.packets[k].ms <= ms; k++)
+    {
+      const Packet& pk = p.packets[k];
+      if (pk.quality >= QUALITY_GATE)
+        count = next = average = 0;
+      else
+      {
+        window[next] = pk.attention;
+        next = (next + 1) % AVERAGING;
+        if (count < AVERAGING)
+          count++;
+        int sum = 0;
+        for (int i = 0; i < count; i++)
+          sum += window[i];
+        average = (int)lround((double)sum / count);
+      }
+      predictorSample(pr, pk.attention, pk.quality, QUALITY_GATE, pk.ms);
+    }
+    p.average.push_back(average);
+    p.predicted.push_back(predictorTick(pr, ms));
+  }
+}
+
+struct Score
+{
+  double lagMs, rmsAtLag, rms, meanStep, maxStep;
+};
+
+static Score score(const std::vector<int>& in, const std::vector<double>& truth, int from)
+{
+  Score s = {};
+  int frames = in.size();
+  double best = 1e30;
+  int maxLag = (int)(MAX_LAG_MS / FRAME_MS);
+  for (int lag = 0; lag <= maxLag; lag++)
+  {
+    double e = 0;
+    int n = 0;
+    for (int f = from + maxLag; f < frames; f++, n++)
+      e += (in[f] - truth[f - lag]) * (in[f] - truth[f - lag]);
+    e = sqrt(e / n);
+    if (lag == 0)
+      s.rms = e;
+    if (e < best)
+    {
+      best = e;
+      s.lagMs = lag * FRAME_MS;
+    }
+  }
+  s.rmsAtLag = best;
+  for (int f = from + 1; f < frames; f++)
+  {
+    double d = fabs((double)in[f] - in[f - 1]);
+    s.meanStep += d;
+    s.maxStep = d > s.maxStep ? d : s.maxStep;
+  }
+  s.meanStep /= frames - from - 1;
+  return s;
+}
+
+// drawPlayers() - the puck moves towards whoever's bar is shorter; count its changes of direction
+template <typename T>
+static double reversalsPerMinute(const std::vector<T>& a, const std::vector<T>& b, int from)
+{
+  int puck = LEDS / 2 * 1000, dir = 0, reversals = 0;
+  for (size_t f = from; f < a.size(); f++)
+  {
+    int lenA = (int)a[f] / 6, lenB = (int)b[f] / 6;
+    int move = 0;
+    if (lenA > lenB) move = lenA > lenB + lenB ? 300 : 200;
+    if (lenA < lenB) move = lenB > lenA + lenA ? -300 : -200;
+    puck = puck + move < 0 ? 0 : puck + move > LEDS * 1000 ? LEDS * 1000 : puck + move;
+    int d = move > 0 ? 1 : move < 0 ? -1 : 0;
+    if (d != 0)
+    {
+      if (dir != 0 && d != dir)
+        reversals++;
+      dir = d;
+    }
+  }
+  return reversals * 60000.0 / ((a.size() - from) * FRAME_MS);
+}
+
+int main(int argc, char** argv)
+{
+  std::vector<Player*> pairs;   // A, B, A, B...
+  const int warmup = (int)(10000 / FRAME_MS);
+  bool tune = argc > 1 && strcmp(argv[1], "-tune") == 0;
+  if (tune)
+  {
+    seed = SEED_TUNE;
+    argv++;
+    argc--;
+  }
+  if (argc > 1)
+  {
+    for (int i = 1; i < argc; i++)
+    {
+      Player* ab = new Player[2];
+      if (!readCapture(argv[i], ab) || ab[0].packets.size() < 30 || ab[1].packets.size() < 30)
+      {
+        fprintf(stderr, "%s: not a history dump with both headsets\n", argv[i]);
+        return 2;
+      }
+      uint32_t start = ab[0].packets.front().ms > ab[1].packets.front().ms ? ab[0].packets.front().ms : ab[1].packets.front().ms;
+      uint32_t end = ab[0].packets.back().ms < ab[1].packets.back().ms ? ab[0].packets.back().ms : ab[1].packets.back().ms;
+      int frames = (int)((end - start) / FRAME_MS);
+      for (int h = 0; h < 2; h++)
+      {
+        joinPackets(ab[h], start, frames);
+        run(ab[h], start, frames);
+      }
+      pairs.push_back(&ab[0]);
+      pairs.push_back(&ab[1]);
+    }
+    printf("%d captures (truth = packets joined up)\n", argc - 1);
+  }
+  else
+  {
+    const int matches = 20, frames = (int)(180000 / FRAME_MS);
+    for (int m = 0; m < matches; m++)
+    {
+      Player* ab = new Player[2];
+      for (int h = 0; h < 2; h++)
+      {
+        ab[h] = synthetic(frames);
+        run(ab[h], 0, frames);
+      }
+      pairs.push_back(&ab[0]);
+      pairs.push_back(&ab[1]);
+    }
+    printf("%d synthetic matches of 3 minutes (%s set)\n", matches, tune ? "tuning" : "held out");
+  }
+
+  Score sum[2] = {};
+  double rev[3] = {};
+  for (size_t i = 0; i < pairs.size(); i++)
+  {
+    Score a = score(pairs[i]->average, pairs[i]->truth, warmup);
+    Score p = score(pairs[i]->predicted, pairs[i]->truth, warmup);
+    Score* s[2] = {&a, &p};
+    for (int k = 0; k < 2; k++)
+    {
+      sum[k].lagMs += s[k]->lagMs / pairs.size();
+      sum[k].rmsAtLag += s[k]->rmsAtLag / pairs.size();
+      sum[k].rms += s[k]->rms / pairs.size();
+      sum[k].meanStep += s[k]->meanStep / pairs.size();
+      sum[k].maxStep = s[k]->maxStep > sum[k].maxStep ? s[k]->maxStep : sum[k].maxStep;
+    }
+  }
+  for (size_t i = 0; i < pairs.size(); i += 2)
+  {
+    double n = pairs.size() / 2;
+    rev[0] += reversalsPerMinute(pairs[i]->truth, pairs[i + 1]->truth, warmup) / n;
+    rev[1] += reversalsPerMinute(pairs[i]->average, pairs[i + 1]->average, warmup) / n;
+    rev[2] += reversalsPerMinute(pairs[i]->predicted, pairs[i + 1]->predicted, warmup) / n;
+  }
+
+  const char* names[2] = {"average", "predictor"};
+  printf("  %-10s %8s %14s %10s %10s %9s %10s\n", "input", "lag ms", "error at lag", "error", "step", "max step", "reversals");
+  for (int k = 0; k < 2; k++)
+    printf("  %-10s %8.0f %14.2f %10.2f %10.3f %9.0f %10.2f\n", names[k], sum[k].lagMs, sum[k].rmsAtLag,
+           sum[k].rms, sum[k].meanStep, sum[k].maxStep, rev[k + 1]);
+  printf("  %-10s %8s %14s %10s %10s %9s %10.2f\n", "player", "", "", "", "", "", rev[0]);
+
+  bool ok = sum[1].lagMs < sum[0].lagMs && sum[1].maxStep <= sum[0].maxStep && rev[2] <= rev[1];
+  printf("%s\n", ok ? "ok" : "FAILED");
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,204 @@
+/*
+  recdecode - turns a Tug32 match recording into CSV.
+
+  Build:  g++ -O2 -o recdecode recdecode.cpp
+  Usage:  recdecode <file> [more files...]  > matches.csv
+
+  A file can be a raw recording (/recN.bin copied off the flash) or a capture of the
+  "rec dump <n>" serial console output (the hex lines between REC and END).
+  The format is described at the top of src/recorder.h.
+
+  A short summary of each match (seed, frames, duration, winner, how often each headset
+  was on an estimated signal) is printed to stderr. The seed is the one the game was played
+  with ("seed <n>" on the console replays its effects); version 1 files don't have it. The winner is read from where the puck
+  was when the match reached DEAD: pushed to B's end (the top of the strip) means A won,
+  to A's end B won. A recording that stops before DEAD (the headsets dropped out) has none.
+*/
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <cctype>
+#include <string>
+#include <vector>
+
+#define REC_DT    0x01
+#define REC_STAGE 0x02
+#define REC_A     0x04
+#define REC_B     0x08
+#define REC_PUCK  0x10
+#define REC_QA    0x20
+#define REC_QB    0x40
+#define REC_KEY   0x80
+
+static const char* stageNames[] = {"STARTUP", "CALIBRATE", "PLAY", "DEAD", "SCREENSAVER"};
+
+static bool readFile(const char* path, std::vector<uint8_t>& out)
+{
+  FILE* f = fopen(path, "rb");
+  if (!f)
+    return false;
+  uint8_t buf[4096];
+  size_t n;
+  while ((n = fread(buf, 1, sizeof(buf), f)) > 0)
+    out.insert(out.end(), buf, buf + n);
+  fclose(f);
+
+  if (out.size() >= 4 && memcmp(out.data(), "TUGR", 4) == 0)
+    return true; // raw recording
+
+  // otherwise treat it as a serial capture - keep the hex lines only
+  std::vector<uint8_t> bin;
+  std::string text(out.begin(), out.end());
+  size_t pos = 0;
+  while (pos < text.size())
+  {
+    size_t end = text.find('\n', pos);
+    if (end == std::string::npos)
+      end = text.size();
+    std::string line = text.substr(pos, end - pos);
+    pos = end + 1;
+    while (!line.empty() && isspace((unsigned char)line.back()))
+      line.pop_back();
+    if (line.empty() || line.size() % 2 != 0)
+      continue;
+    bool hex = true;
+    for (char c : line)
+      hex &= isxdigit((unsigned char)c) != 0;
+    if (!hex)
+      continue;
+    for (size_t i = 0; i < line.size(); i += 2)
+      bin.push_back((uint8_t)strtoul(line.substr(i, 2).c_str(), nullptr, 16));
+  }
+  out.swap(bin);
+  return true;
+}
+
+struct Reader
+{
+  const std::vector<uint8_t>& d;
+  size_t pos;
+  bool ok;
+
+  uint8_t byte()
+  {
+    if (pos >= d.size()) { ok = false; return 0; }
+    return d[pos++];
+  }
+  uint32_t varint()
+  {
+    uint32_t v = 0;
+    for (int shift = 0; shift < 35; shift += 7)
+    {
+      uint8_t b = byte();
+      v |= (uint32_t)(b & 0x7f) << shift;
+      if (!(b & 0x80))
+        break;
+    }
+    return v;
+  }
+  int32_t zigzag()
+  {
+    uint32_t v = varint();
+    return (int32_t)(v >> 1) ^ -(int32_t)(v & 1);
+  }
+};
+
+static int decode(const char* path, int match, bool header)
+{
+  std::vector<uint8_t> data;
+  if (!readFile(path, data))
+  {
+    fprintf(stderr, "%s: can't read\n", path);
+    return 1;
+  }
+  if (data.size() < 8 || memcmp(data.data(), "TUGR", 4) != 0)
+  {
+    fprintf(stderr, "%s: not a recording\n", path);
+    return 1;
+  }
+  int version = data[4];
+  int qualityGate = data[5];
+  if (version != 1 && version != 2)
+  {
+    fprintf(stderr, "%s: unknown version %d\n", path, version);
+    return 1;
+  }
+  size_t headerSize = version == 1 ? 8 : 12;
+  if (data.size() < headerSize)
+  {
+    fprintf(stderr, "%s: not a recording\n", path);
+    return 1;
+  }
+  char seed[16] = "not recorded";
+  if (version >= 2)
+    snprintf(seed, sizeof(seed), "%u", data[8] | data[9] << 8 | data[10] << 16 | (uint32_t)data[11] << 24);
+
+  if (header)
+    printf("match,frame,time_ms,stage,playerA,playerB,puck,qualityA,qualityB,estimatedA,estimatedB\n");
+
+  Reader r = {data, headerSize, true};
+  int dt = 0, stage = 0, a = 0, b = 0, puck = 0, qa = 0, qb = 0;
+  long timeMs = 0;
+  long frames = 0, estA = 0, estB = 0, playFrames = 0;
+  const char* winner = "none - ended before the puck reached an end";
+  bool finished = false;
+  while (r.pos < data.size())
+  {
+    uint8_t flags = r.byte();
+    if (flags & REC_KEY)
+      dt = stage = a = b = puck = qa = qb = 0;
+    if (flags & REC_DT) dt = r.varint();
+    if (flags & REC_STAGE) stage = r.byte();
+    if (flags & REC_A) a += r.zigzag();
+    if (flags & REC_B) b += r.zigzag();
+    if (flags & REC_PUCK) puck += r.zigzag();
+    if (flags & REC_QA) qa += r.zigzag();
+    if (flags & REC_QB) qb += r.zigzag();
+    if (!r.ok)
+    {
+      fprintf(stderr, "%s: truncated at byte %zu\n", path, r.pos);
+      break;
+    }
+    if (frames > 0)
+      timeMs += dt;
+
+    // same rule as Brain::update - some signal but under the gate means the attention was estimated
+    int eA = (qa > 0 && qa < qualityGate);
+    int eB = (qb > 0 && qb < qualityGate);
+    const char* stageName = stage < 5 ? stageNames[stage] : "?";
+    printf("%d,%ld,%ld,%s,%d,%d,%d,%d,%d,%d,%d\n", match, frames, timeMs, stageName, a, b, puck, qa, qb, eA, eB);
+
+    if (stage == 3 && playFrames > 0 && !finished)
+    {// die() - the puck came within 5 leds of A's end, or of B's
+      winner = puck < 5 ? "B" : "A";
+      finished = true;
+    }
+
+    frames++;
+    if (stage == 2)
+    {
+      playFrames++;
+      estA += eA;
+      estB += eB;
+    }
+  }
+
+  fprintf(stderr, "%s: seed %s, %ld frames, %.1f s, winner %s, puck ended at %d, estimated A %.0f%% B %.0f%% of play\n",
+          path, seed, frames, timeMs / 1000.0, winner, puck,
+          playFrames ? 100.0 * estA / playFrames : 0.0,
+          playFrames ? 100.0 * estB / playFrames : 0.0);
+  return 0;
+}
+
+int main(int argc, char** argv)
+{
+  if (argc < 2)
+  {
+    fprintf(stderr, "usage: %s <recording> [more recordings...]\n", argv[0]);
+    return 2;
+  }
+  int err = 0;
+  for (int i = 1; i < argc; i++)
+    err |= decode(argv[i], i - 1, i == 1);
+  return err;
+}
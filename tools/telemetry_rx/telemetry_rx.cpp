@@ -0,0 +1,127 @@
+/*
+  telemetry_rx - receives the Tug32 UDP telemetry and prints it as CSV.
+
+  Build:  g++ -O2 -o telemetry_rx telemetry_rx.cpp
+  Usage:  telemetry_rx [port]  > live.csv
+
+  Listens on the telemetry port (4210 unless given) for the datagrams broadcast by the board
+  (format at the top of src/telemetry.h). Every sample is one CSV line on stdout; once a
+  second a line of live stats (rate, lost datagrams, mean attention of each player) goes to
+  stderr. Test it without a board by sending datagrams to 127.0.0.1 on the same port.
+*/
+#include <cstdio>
+#include <cstdint>
+#include <cstdlib>
+#include <ctime>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <unistd.h>
+#include <initializer_list>
+
+#define TELEMETRY_VERSION 1
+#define TELEMETRY_HEADER 6
+#define EEG_POWER_BANDS 8
+#define TELEMETRY_PLAYER_BYTES (4 + EEG_POWER_BANDS * 3)
+#define TELEMETRY_SAMPLE_BYTES (4 + 1 + 2 + 2 * TELEMETRY_PLAYER_BYTES)
+
+static const char* stageNames[] = {"STARTUP", "CALIBRATE", "PLAY", "DEAD", "SCREENSAVER"};
+
+struct Stats
+{
+  long samples = 0;
+  long datagrams = 0;
+  long lost = 0;
+  long attention[2] = {0, 0};
+};
+
+static uint32_t get16(const uint8_t* p) { return p[0] | (p[1] << 8); }
+static uint32_t get24(const uint8_t* p) { return p[0] | (p[1] << 8) | (p[2] << 16); }
+static uint32_t get32(const uint8_t* p) { return get24(p) | ((uint32_t)p[3] << 24); }
+
+static const uint8_t* printPlayer(const uint8_t* p, int& attention)
+{
+  attention = p[0];
+  printf(",%u,%u,%u,%u", p[0], p[1], p[2], p[3]);
+  p += 4;
+  for (int i = 0; i < EEG_POWER_BANDS; i++, p += 3)
+    printf(",%u", get24(p));
+  return p;
+}
+
+int main(int argc, char** argv)
+{
+  int port = argc > 1 ? atoi(argv[1]) : 4210;
+
+  int sock = socket(AF_INET, SOCK_DGRAM, 0);
+  int yes = 1;
+  setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes));
+  sockaddr_in addr = {};
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(port);
+  addr.sin_addr.s_addr = htonl(INADDR_ANY);
+  if (bind(sock, (sockaddr*)&addr, sizeof(addr)) < 0)
+  {
+    perror("bind");
+    return 1;
+  }
+  fprintf(stderr, "listening on udp port %d\n", port);
+
+  printf("millis,stage,puck");
+  for (const char* player : {"A", "B"})
+  {
+    printf(",attention%s,average%s,quality%s,qualityRaw%s", player, player, player, player);
+    for (const char* band : {"delta", "theta", "lowAlpha", "highAlpha", "lowBeta", "highBeta", "lowGamma", "midGamma"})
+      printf(",%s%s", band, player);
+  }
+  printf("\n");
+
+  Stats stats;
+  bool haveSeq = false;
+  uint16_t nextSeq = 0;
+  time_t lastReport = time(nullptr);
+  uint8_t buf[1500];
+  for (;;)
+  {
+    ssize_t n = recv(sock, buf, sizeof(buf), 0);
+    if (n < TELEMETRY_HEADER || buf[0] != 'T' || buf[1] != 'G' || buf[2] != TELEMETRY_VERSION)
+      continue;
+    int count = buf[3];
+    uint16_t seq = get16(buf + 4);
+    if (n < TELEMETRY_HEADER + count * TELEMETRY_SAMPLE_BYTES)
+      continue;
+
+    if (haveSeq && seq != nextSeq)
+      stats.lost += (uint16_t)(seq - nextSeq);
+    haveSeq = true;
+    nextSeq = seq + 1;
+    stats.datagrams++;
+
+    const uint8_t* p = buf + TELEMETRY_HEADER;
+    for (int s = 0; s < count; s++)
+    {
+      uint32_t ms = get32(p);
+      int stage = p[4];
+      int puck = get16(p + 5);
+      printf("%u,%s,%d", ms, stage < 5 ? stageNames[stage] : "?", puck);
+      p += 7;
+      int attA, attB;
+      p = printPlayer(p, attA);
+      p = printPlayer(p, attB);
+      printf("\n");
+      stats.samples++;
+      stats.attention[0] += attA;
+      stats.attention[1] += attB;
+    }
+    fflush(stdout);
+
+    time_t now = time(nullptr);
+    if (now != lastReport && stats.samples > 0)
+    {
+      fprintf(stderr, "%ld samples/s, %ld datagrams, %ld lost, mean attention A %ld B %ld\n",
+              stats.samples / (long)(now - lastReport), stats.datagrams, stats.lost,
+              stats.attention[0] / stats.samples, stats.attention[1] / stats.samples);
+      stats.samples = stats.attention[0] = stats.attention[1] = 0;
+      lastReport = now;
+    }
+  }
+}